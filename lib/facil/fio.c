@@ -41,7 +41,8 @@ Feel free to copy, use and enjoy according to the license provided.
 #define FIO_ENGINE_POLL 0
 #endif
 
-#if !FIO_ENGINE_POLL && !FIO_ENGINE_EPOLL && !FIO_ENGINE_KQUEUE
+#if !FIO_ENGINE_POLL && !FIO_ENGINE_EPOLL && !FIO_ENGINE_KQUEUE &&             \
+    !FIO_ENGINE_IO_URING
 #if defined(__linux__)
 #define FIO_ENGINE_EPOLL 1
 #elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) ||     \
@@ -52,11 +53,25 @@ Feel free to copy, use and enjoy according to the license provided.
 #endif
 #endif
 
+/* edge triggered epoll (fds are registered once, no per-event re-arming) */
+#ifndef FIO_POLL_EDGE
+#define FIO_POLL_EDGE 0
+#endif
+#if FIO_POLL_EDGE && !FIO_ENGINE_EPOLL
+#undef FIO_POLL_EDGE
+#define FIO_POLL_EDGE 0
+#endif
+
 /* for kqueue and epoll only */
 #ifndef FIO_POLL_MAX_EVENTS
 #define FIO_POLL_MAX_EVENTS 64
 #endif
 
+/* for io_uring only - the submission ring size */
+#ifndef FIO_POLL_URING_ENTRIES
+#define FIO_POLL_URING_ENTRIES 4096
+#endif
+
 #ifndef FIO_POLL_TICK
 #define FIO_POLL_TICK 1000
 #endif
@@ -69,11 +84,93 @@ Feel free to copy, use and enjoy according to the license provided.
 #define DEBUG_SPINLOCK 0
 #endif
 
+/* the maximum number of connections accepted per listening socket event */
+#ifndef FIO_LISTEN_ACCEPT_BATCH
+#define FIO_LISTEN_ACCEPT_BATCH 32
+#endif
+
+/*
+ * The capacity of a packet that coalesces small copied writes (`fio_write`).
+ *
+ * Writes to an empty queue are copied to a packet of their exact length, a
+ * coalescing packet is allocated only once small writes are actually queued.
+ */
+#ifndef FIO_WRITE_COALESCE_SIZE
+#define FIO_WRITE_COALESCE_SIZE 4096
+#endif
+
+/* connection timeout review buckets (one per second, a power of 2 > 300) */
+#ifndef FIO_TIMEOUT_BUCKETS
+#define FIO_TIMEOUT_BUCKETS 512
+#endif
+
+/* pooled read buffers kept per thread and (per size class) by the process */
+#ifndef FIO_BUFFER_POOL_CACHE
+#define FIO_BUFFER_POOL_CACHE 8
+#endif
+#ifndef FIO_BUFFER_POOL_LIMIT
+#define FIO_BUFFER_POOL_LIMIT 256
+#endif
+
+/* `fio_splice` moves data using the `splice` system call (Linux only) */
+#ifndef FIO_SPLICE
+#if defined(__linux__)
+#define FIO_SPLICE 1
+#else
+#define FIO_SPLICE 0
+#endif
+#endif
+
+/* the maximum number of bytes `fio_splice` moves per event and direction */
+#ifndef FIO_SPLICE_CHUNK
+#define FIO_SPLICE_CHUNK 65536
+#endif
+
+/* connections per connection table page (as a power of 2) */
+#ifndef FIO_FD_PAGE_BITS
+#define FIO_FD_PAGE_BITS 8
+#endif
+
+/* default outgoing queue watermarks in bytes (see `fio_watermarks_set`) */
+#ifndef FIO_WATERMARK_HIGH
+#define FIO_WATERMARK_HIGH (1UL << 20)
+#endif
+#ifndef FIO_WATERMARK_LOW
+#define FIO_WATERMARK_LOW (1UL << 18)
+#endif
+
 /* Slowloris mitigation  (must be less than 1<<16) */
 #ifndef FIO_SLOWLORIS_LIMIT
 #define FIO_SLOWLORIS_LIMIT (1 << 10)
 #endif
 
+/* zero-copy transmission (MSG_ZEROCOPY) requires Linux and epoll / io_uring */
+#ifndef FIO_ZEROCOPY
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) &&    \
+    (FIO_ENGINE_EPOLL || FIO_ENGINE_IO_URING)
+#define FIO_ZEROCOPY 1
+#else
+#define FIO_ZEROCOPY 0
+#endif
+#endif
+
+#if FIO_ZEROCOPY
+#include <linux/errqueue.h>
+#endif
+
+/* CPU affinity (pinning workers and threads to CPU cores) requires Linux */
+#ifndef FIO_AFFINITY
+#if defined(__linux__)
+#define FIO_AFFINITY 1
+#else
+#define FIO_AFFINITY 0
+#endif
+#endif
+
+#if FIO_AFFINITY
+#include <sched.h>
+#endif
+
 #if !defined(__clang__) && !defined(__GNUC__)
 #define __thread _Thread_value
 #endif
@@ -99,8 +196,19 @@ static void deferred_on_close(void *uuid_, void *pr_);
 static void deferred_on_shutdown(void *arg, void *arg2);
 static void deferred_on_ready(void *arg, void *arg2);
 static void deferred_on_data(void *uuid, void *arg2);
+static void deferred_on_congestion(void *arg, void *arg2);
 static void deferred_ping(void *arg, void *arg2);
 
+/* returns 0 if a socket error was (only) a zero-copy completion notification */
+FIO_FUNC int fio_zerocopy_on_error(intptr_t uuid);
+
+/* pins the worker process to a set of CPU cores (if requested) */
+static void fio_affinity_pin_worker(size_t id);
+/* pins the calling pool thread to a CPU core (if requested) */
+static void fio_affinity_pin_thread(size_t index);
+/* prefers the allocator's arena that matches the CPU core */
+FIO_FUNC void fio_mem_arena_bind(size_t cpu);
+
 /* *****************************************************************************
 Section Start Marker
 
@@ -147,52 +255,122 @@ struct fio_packet_s {
   } data;
   uintptr_t offset;
   uintptr_t length;
+#if FIO_ZEROCOPY
+  /* the last zero-copy send call referencing the data (+1), 0 if none */
+  uint32_t zerocopy_id;
+#endif
 };
 
-/** Connection data (fd_data) */
+/**
+ * Connection data (fd_data) - the state reviewed for every IO event.
+ *
+ * Entries are cache line aligned and must fit in a single cache line (64
+ * bytes), anything else belongs in the connection's `fio_fd_cold_s` data.
+ */
 typedef struct {
   /* current data to be send */
   fio_packet_s *packet;
-  /** the last packet in the queue. */
-  fio_packet_s **packet_last;
-  /* Data sent so far */
-  size_t sent;
   /* fd protocol */
   fio_protocol_s *protocol;
+  /** RW hooks. */
+  fio_rw_hook_s *rw_hooks;
+  /** RW udata. */
+  void *rw_udata;
   /* timer handler */
   time_t active;
-  /** The number of pending packets that are in the queue. */
-  uint16_t packet_count;
-  /* timeout settings */
-  uint8_t timeout;
+  /* `on_data` CPU budget per reactor cycle (microseconds), 0 == unlimited */
+  uint32_t budget;
+  /* CPU time consumed by `on_data` since the last IO event (or postponement) */
+  uint32_t budget_used;
   /* indicates that the fd should be considered scheduled (added to poll) */
   fio_lock_i scheduled;
   /* protocol lock */
   fio_lock_i protocol_lock;
-  /* used to convert `fd` to `uuid` and validate connections */
-  uint8_t counter;
   /* socket lock */
   fio_lock_i sock_lock;
+  /* used to convert `fd` to `uuid` and validate connections */
+  uint8_t counter;
   /** Connection is open */
   uint8_t open;
   /** indicated that the connection should be closed. */
   uint8_t close;
+  /* timeout settings */
+  uint8_t timeout;
+  /* registered once (exclusive, edge triggered), events aren't re-armed */
+  uint8_t exclusive;
+#if FIO_POLL_EDGE
+  /* the last read returned data (the socket might not be drained yet) */
+  uint8_t read_more;
+  /* a read event was skipped while `on_data` was scheduled (or running) */
+  volatile uint8_t read_pending;
+  /* the socket was writable since the last write that didn't block */
+  volatile uint8_t ready_write;
+  /* a write event is expected (see `fio_poll_add_write`) */
+  volatile uint8_t want_write;
+#endif
+#if FIO_ENGINE_IO_URING
+  /* pending poll requests (read, write) */
+  fio_lock_i uring_armed[2];
+#endif
+} __attribute__((aligned(64))) fio_fd_data_s;
+
+/** Connection data that isn't required for every IO event (fd_cold). */
+typedef struct {
+  /** the last packet in the queue. */
+  fio_packet_s **packet_last;
+  /* Data sent so far */
+  size_t sent;
+  /* the number of bytes waiting in the outgoing queue */
+  size_t pending_bytes;
+  /* outgoing queue watermarks (bytes), see `fio_watermarks_set` */
+  size_t watermark_high;
+  size_t watermark_low;
+  /** The number of pending packets that are in the queue. */
+  uint16_t packet_count;
+  /* the outgoing queue grew beyond the high watermark (and didn't drain) */
+  uint8_t congested;
+  /* the congestion state last reported to the protocol */
+  uint8_t congested_notified;
+  /* the connection's position in the connection table */
+  uint32_t fd;
+  /* timeout review bucket node (see `fio_timeout_schedule_unsafe`) */
+  fio_ls_embd_s timeout_node;
+  /* Objects linked to the UUID */
+  fio_uuid_links_s links;
+#if FIO_ZEROCOPY
+  /* buffers this size (or larger) are sent using MSG_ZEROCOPY (0 == off) */
+  size_t zerocopy;
+  /* sent packets waiting for the kernel's zero-copy completion */
+  fio_packet_s *zerocopy_pending;
+  /** the last packet in the zero-copy completion queue. */
+  fio_packet_s **zerocopy_pending_last;
+  /* zero-copy send calls (counted) and completed */
+  uint32_t zerocopy_sent;
+  uint32_t zerocopy_done;
+#endif
   /** peer address length */
   uint8_t addr_len;
   /** peer address length */
   uint8_t addr[48];
-  /** RW hooks. */
-  fio_rw_hook_s *rw_hooks;
-  /** RW udata. */
-  void *rw_udata;
-  /* Objects linked to the UUID */
-  fio_uuid_links_s links;
-} fio_fd_data_s;
+} fio_fd_cold_s;
+
+#define FIO_FD_PAGE_SIZE ((uintptr_t)1 << FIO_FD_PAGE_BITS)
+#define FIO_FD_PAGE_MASK (FIO_FD_PAGE_SIZE - 1)
+
+/* a connection table page (see `fio_fd_data_reserve`) */
+typedef struct {
+  fio_fd_data_s hot[FIO_FD_PAGE_SIZE];
+  fio_fd_cold_s cold[FIO_FD_PAGE_SIZE];
+  /* the allocation the (cache line aligned) page was placed in */
+  void *mem;
+} fio_fd_page_s;
 
 typedef struct {
   struct timespec last_cycle;
   /* connection capacity */
   uint32_t capa;
+  /* connection table entries allocated so far (grows a page at a time) */
+  volatile uint32_t fd_limit;
   /* connections counted towards shutdown (NOT while running) */
   uint32_t connection_count;
   /* thread list */
@@ -201,12 +379,24 @@ typedef struct {
   uint16_t workers;
   /* timer handler */
   uint16_t threads;
-  /* timeout review loop flag */
-  uint8_t need_review;
   /* spinning down process */
   uint8_t volatile active;
   /* worker process flag - true also for single process */
   uint8_t is_worker;
+  /* each thread polls it's own connections */
+  uint8_t reactor_per_thread;
+  /* pin each worker process to a set of CPU cores */
+  uint8_t pin_workers;
+  /* pin each thread to a CPU core */
+  uint8_t pin_threads;
+  /* the worker's index (used for CPU affinity) */
+  uint16_t worker_id;
+  /* adaptive thread pool limit (0 == fixed size pool) */
+  uint16_t max_threads;
+  /* adaptive thread pool growth delay (milliseconds) */
+  uint16_t grow_delay;
+  /* adaptive thread pool idle timeout (seconds) */
+  uint16_t idle_timeout;
   /* polling and global lock */
   fio_lock_i lock;
   /* The highest active fd with a protocol object */
@@ -216,7 +406,8 @@ typedef struct {
 #if FIO_ENGINE_POLL
   struct pollfd *poll;
 #endif
-  fio_fd_data_s info[];
+  /* connection table pages (allocated on demand, never moved) */
+  fio_fd_page_s *pages[];
 } fio_data_s;
 
 /** The logging level */
@@ -239,11 +430,183 @@ union protocol_metadata_union_u {
   protocol_metadata_s meta;
 };
 
-#define fd_data(fd) (fio_data->info[(uintptr_t)(fd)])
+#define fd_data(fd)                                                            \
+  (fio_data->pages[(uintptr_t)(fd) >> FIO_FD_PAGE_BITS]                        \
+       ->hot[(uintptr_t)(fd)&FIO_FD_PAGE_MASK])
+#define fd_cold(fd)                                                            \
+  (fio_data->pages[(uintptr_t)(fd) >> FIO_FD_PAGE_BITS]                        \
+       ->cold[(uintptr_t)(fd)&FIO_FD_PAGE_MASK])
+#define uuid_cold(uuid) fd_cold(fio_uuid2fd((uuid)))
 #define uuid_data(uuid) fd_data(fio_uuid2fd((uuid)))
 #define fd2uuid(fd)                                                            \
   ((intptr_t)((((uintptr_t)(fd)) << 8) | fd_data((fd)).counter))
 
+/* *****************************************************************************
+Runtime statistics counters (aggregated by `fio_stats`)
+***************************************************************************** */
+
+#ifndef FIO_STATS_SLOTS
+/* The number of counter slots (a power of 2), threads rarely share a slot */
+#define FIO_STATS_SLOTS 16
+#endif
+
+/* a cache line of counters, (mostly) written by a single thread */
+typedef union {
+  struct {
+    size_t poll_calls;
+    size_t poll_events;
+    size_t poll_arms;
+    size_t read_calls;
+    size_t bytes_read;
+    size_t bytes_written;
+    size_t thread_parks;
+    size_t thread_wakes;
+  } c;
+  uint8_t padding[64];
+} fio_stats_slot_u;
+
+static fio_stats_slot_u fio_stats_slots[FIO_STATS_SLOTS];
+/* the current thread's slot index (+1), 0 == unassigned */
+static __thread size_t fio_stats_slot_id;
+
+/* returns the current thread's counter slot index */
+static inline size_t fio_stats_slot(void) {
+  static size_t counter = 0;
+  if (!fio_stats_slot_id)
+    fio_stats_slot_id = fio_atomic_add(&counter, 1);
+  return fio_stats_slot_id & (FIO_STATS_SLOTS - 1);
+}
+
+/* adds a value to one of the current thread's counters */
+#define fio_stats_add(counter, value)                                          \
+  fio_atomic_add(&fio_stats_slots[fio_stats_slot()].c.counter, (size_t)(value))
+
+/* *****************************************************************************
+Edge triggered readiness tracking (see `FIO_POLL_EDGE`)
+***************************************************************************** */
+
+#if FIO_POLL_EDGE
+/* records if the last read returned data, so `on_data` is re-queued */
+#define fio_edge_read_more(fd, more) (fd_data((fd)).read_more = (more))
+/* marks the socket as (possibly) blocked, before a write is attempted */
+#define fio_edge_write_begin(fd) fio_atomic_xchange(&fd_data((fd)).ready_write, 0)
+/* marks the socket as writable (a write didn't block) */
+#define fio_edge_write_done(fd) fio_atomic_xchange(&fd_data((fd)).ready_write, 1)
+#else
+#define fio_edge_read_more(fd, more) ((void)0)
+#define fio_edge_write_begin(fd) ((void)0)
+#define fio_edge_write_done(fd) ((void)0)
+#endif
+
+/* a monotonic nanosecond clock (for measuring durations) */
+static inline uint64_t fio_monotonic_ns(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return ((uint64_t)t.tv_sec * 1000000000) + (uint64_t)t.tv_nsec;
+}
+
+/* the calling thread's CPU time in nanoseconds (for CPU budgets) */
+static inline uint64_t fio_thread_cpu_ns(void) {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  struct timespec t;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+  return ((uint64_t)t.tv_sec * 1000000000) + (uint64_t)t.tv_nsec;
+#else
+  return fio_monotonic_ns();
+#endif
+}
+
+#ifndef FIO_HISTOGRAMS
+/* Collects latency histograms (costs two clock reads per task) */
+#define FIO_HISTOGRAMS 1
+#endif
+
+#ifndef FIO_HISTOGRAM_LOG_INTERVAL
+/* Logs the latency histograms every interval (milliseconds), 0 == never */
+#define FIO_HISTOGRAM_LOG_INTERVAL 0
+#endif
+
+/* per thread (slot) latency histograms, merged by `fio_histogram` */
+static fio_histogram_s fio_histogram_slots[FIO_STATS_SLOTS]
+                                          [FIO_HISTOGRAM_TYPES];
+
+/*
+ * Returns a value's histogram bucket. Values below 4 have their own bucket,
+ * larger values are split into 4 buckets per power of 2 (~25% precision).
+ */
+static inline size_t fio_histogram_index(uint64_t value) {
+  if (value < 4)
+    return (size_t)value;
+  size_t msb = 0;
+  uint64_t tmp = value;
+  if (tmp >> 32) {
+    tmp >>= 32;
+    msb += 32;
+  }
+  if (tmp >> 16) {
+    tmp >>= 16;
+    msb += 16;
+  }
+  if (tmp >> 8) {
+    tmp >>= 8;
+    msb += 8;
+  }
+  if (tmp >> 4) {
+    tmp >>= 4;
+    msb += 4;
+  }
+  if (tmp >> 2) {
+    tmp >>= 2;
+    msb += 2;
+  }
+  if (tmp >> 1)
+    msb += 1;
+  const size_t index = ((msb - 1) << 2) | ((value >> (msb - 2)) & 3);
+  return (index < FIO_HISTOGRAM_BUCKETS ? index : FIO_HISTOGRAM_BUCKETS - 1);
+}
+
+/* returns the highest value counted by a histogram bucket */
+static inline uint64_t fio_histogram_bucket_max(size_t index) {
+  if (index < 4)
+    return index;
+  const size_t shift = (index >> 2) - 1;
+  return ((uint64_t)(4 | (index & 3)) << shift) + ((uint64_t)1 << shift) - 1;
+}
+
+/* records a duration (in nanoseconds) in the current thread's histogram */
+static inline void fio_histogram_add(fio_histogram_e type, uint64_t ns) {
+  if (!FIO_HISTOGRAMS)
+    return;
+  fio_histogram_s *h = &fio_histogram_slots[fio_stats_slot()][type];
+  fio_atomic_add(&h->buckets[fio_histogram_index(ns)], 1);
+  fio_atomic_add(&h->count, 1);
+  fio_atomic_add(&h->total, (size_t)ns);
+  if (h->max < ns) /* might be lost if threads share a slot, that's okay */
+    h->max = (size_t)ns;
+}
+
+/* returns the time (for measuring durations), or 0 if histograms are off */
+static inline uint64_t fio_histogram_now(void) {
+  return FIO_HISTOGRAMS ? fio_monotonic_ns() : 0;
+}
+
+/* counts a polling call, the number of events it returned and it's duration */
+static inline size_t fio_stats_poll(size_t events, uint64_t start) {
+  fio_stats_add(poll_calls, 1);
+  if (events)
+    fio_stats_add(poll_events, events);
+  fio_histogram_add(FIO_HISTOGRAM_POLL, fio_histogram_now() - start);
+  return events;
+}
+
+#if FIO_ZEROCOPY
+/* a closing connection waiting for zero-copy completions (errors only) */
+#define fio_zerocopy_closing(fd)                                               \
+  (fd_data(fd).close && !fd_data(fd).packet && fd_cold(fd).zerocopy_pending)
+#else
+#define fio_zerocopy_closing(fd) 0
+#endif
+
 /**
  * Returns the maximum number of open files facil.io can handle per worker
  * process.
@@ -273,6 +636,19 @@ static inline fio_packet_s *fio_packet_alloc(void) {
   return packet;
 }
 
+/* marks packets that store (copied) data in the same allocation */
+static void fio_packet_inline_dealloc(void *buffer) { (void)buffer; }
+
+/* marks inline packets allocated for their data's exact length (no room) */
+static void fio_packet_exact_dealloc(void *buffer) { (void)buffer; }
+
+/* allocates a packet with `capa` bytes of inline buffer storage */
+static inline fio_packet_s *fio_packet_alloc_inline(size_t capa) {
+  fio_packet_s *packet = fio_malloc(sizeof(*packet) + capa);
+  FIO_ASSERT_ALLOC(packet);
+  return packet;
+}
+
 /* *****************************************************************************
 Core Connection Data Clearing
 ***************************************************************************** */
@@ -298,6 +674,66 @@ static void fio_max_fd_shrink(void) {
 }
 
 /* resets connection data, marking it as either open or closed. */
+/* *****************************************************************************
+Connection Timeout Buckets
+***************************************************************************** */
+
+/*
+ * Connections are placed in a bucket according to the second in which their
+ * timeout expires (`active + timeout`). Activity (`fio_touch`) only updates
+ * `active`, the bucket is corrected lazily when it's reviewed.
+ */
+static struct {
+  fio_ls_embd_s buckets[FIO_TIMEOUT_BUCKETS];
+  /* the last second that was reviewed */
+  time_t reviewed;
+  fio_lock_i lock;
+  uint8_t initialized;
+} fio_timeouts = {.lock = FIO_LOCK_INIT};
+
+/* returns the second in which the connection's timeout expires */
+static inline time_t fio_timeout_due(intptr_t fd) {
+  uint16_t timeout = fd_data(fd).timeout;
+  if (!timeout)
+    timeout = 300; /* enforced timout settings */
+  return fd_data(fd).active + timeout;
+}
+
+/* places a connection in the bucket matching it's timeout (lock required) */
+static void fio_timeout_schedule_unsafe(intptr_t fd) {
+  if (!fio_timeouts.initialized) {
+    for (size_t i = 0; i < FIO_TIMEOUT_BUCKETS; ++i) {
+      fio_timeouts.buckets[i] =
+          (fio_ls_embd_s)FIO_LS_INIT(fio_timeouts.buckets[i]);
+    }
+    fio_timeouts.reviewed = fio_data->last_cycle.tv_sec;
+    fio_timeouts.initialized = 1;
+  }
+  time_t due = fio_timeout_due(fd);
+  if (due <= fio_timeouts.reviewed)
+    due = fio_timeouts.reviewed + 1;
+  fio_ls_embd_remove(&fd_cold(fd).timeout_node);
+  fio_ls_embd_push(
+      fio_timeouts.buckets + ((uintptr_t)due & (FIO_TIMEOUT_BUCKETS - 1)),
+      &fd_cold(fd).timeout_node);
+}
+
+/* places a connection in the bucket matching it's timeout */
+static void fio_timeout_schedule(intptr_t fd) {
+  fio_lock(&fio_timeouts.lock);
+  fio_timeout_schedule_unsafe(fd);
+  fio_unlock(&fio_timeouts.lock);
+}
+
+/* removes a connection from the timeout review buckets */
+static inline void fio_timeout_unschedule(intptr_t fd) {
+  if (!fd_cold(fd).timeout_node.next)
+    return;
+  fio_lock(&fio_timeouts.lock);
+  fio_ls_embd_remove(&fd_cold(fd).timeout_node);
+  fio_unlock(&fio_timeouts.lock);
+}
+
 static inline int fio_clear_fd(intptr_t fd, uint8_t is_open) {
   fio_packet_s *packet;
   fio_protocol_s *protocol;
@@ -305,8 +741,16 @@ static inline int fio_clear_fd(intptr_t fd, uint8_t is_open) {
   void *rw_udata;
   fio_uuid_links_s links;
   fio_lock(&(fd_data(fd).sock_lock));
-  links = fd_data(fd).links;
+  fio_timeout_unschedule(fd);
+  links = fd_cold(fd).links;
   packet = fd_data(fd).packet;
+#if FIO_ZEROCOPY
+  if (fd_cold(fd).zerocopy_pending) {
+    /* append packets waiting for a zero-copy completion, the fd is closed */
+    *fd_cold(fd).packet_last = fd_cold(fd).zerocopy_pending;
+    packet = fd_data(fd).packet;
+  }
+#endif
   protocol = fd_data(fd).protocol;
   rw_hooks = fd_data(fd).rw_hooks;
   rw_udata = fd_data(fd).rw_udata;
@@ -316,6 +760,9 @@ static inline int fio_clear_fd(intptr_t fd, uint8_t is_open) {
       .protocol_lock = fd_data(fd).protocol_lock,
       .rw_hooks = (fio_rw_hook_s *)&FIO_DEFAULT_RW_HOOKS,
       .counter = fd_data(fd).counter + 1,
+  };
+  fd_cold(fd) = (fio_fd_cold_s){
+      .fd = (uint32_t)fd,
       .packet_last = &fd_data(fd).packet,
   };
   fio_unlock(&(fd_data(fd).sock_lock));
@@ -341,6 +788,50 @@ static inline int fio_clear_fd(intptr_t fd, uint8_t is_open) {
   return 0;
 }
 
+/*
+ * Makes sure the connection table covers `fd`, returns -1 if `fd` is beyond
+ * the capacity.
+ *
+ * Pages are allocated in order (up to the highest fd seen), so any fd below
+ * `fio_data->fd_limit` can be accessed without testing for a missing page.
+ */
+static int fio_fd_data_reserve(intptr_t fd) {
+  if ((uintptr_t)fd < fio_data->fd_limit)
+    return 0;
+  if ((uintptr_t)fd >= fio_data->capa) {
+    errno = EMFILE;
+    return -1;
+  }
+  fio_lock(&fio_data->lock);
+  while (fio_data->fd_limit <= (uintptr_t)fd) {
+    const uintptr_t start = fio_data->fd_limit;
+    void *mem = fio_mmap(sizeof(fio_fd_page_s) + 64);
+    FIO_ASSERT_ALLOC(mem);
+    /* connection data is cache line aligned */
+    fio_fd_page_s *page = (void *)(((uintptr_t)mem + 63) & (~(uintptr_t)63));
+    page->mem = mem;
+    fio_data->pages[start >> FIO_FD_PAGE_BITS] = page;
+    for (uintptr_t i = start; i < start + FIO_FD_PAGE_SIZE; ++i) {
+      fio_clear_fd(i, 0);
+#if FIO_ENGINE_POLL
+      fio_data->poll[i].fd = -1;
+#endif
+    }
+    /* publish the page only after it was initialized */
+    fio_atomic_xchange(&fio_data->fd_limit, start + FIO_FD_PAGE_SIZE);
+  }
+  fio_unlock(&fio_data->lock);
+  return 0;
+}
+
+/* releases the connection table pages */
+static void fio_fd_data_destroy(void) {
+  for (uintptr_t i = 0; i < fio_data->fd_limit; i += FIO_FD_PAGE_SIZE) {
+    fio_free(fio_data->pages[i >> FIO_FD_PAGE_BITS]->mem);
+  }
+  fio_data->fd_limit = 0;
+}
+
 static inline void fio_force_close_in_poll(intptr_t uuid) {
   uuid_data(uuid).close = 2;
   fio_force_close(uuid);
@@ -386,7 +877,7 @@ inline static void protocol_unlock(fio_protocol_s *pr,
 /** returns 1 if the UUID is valid and 0 if it isn't. */
 #define uuid_is_valid(uuid)                                                    \
   ((intptr_t)(uuid) >= 0 &&                                                    \
-   ((uint32_t)fio_uuid2fd((uuid))) < fio_data->capa &&                         \
+   ((uint32_t)fio_uuid2fd((uuid))) < fio_data->fd_limit &&                     \
    ((uintptr_t)(uuid)&0xFF) == uuid_data((uuid)).counter)
 
 /* public API. */
@@ -410,7 +901,7 @@ UUID validation and state
 
 /* public API. */
 intptr_t fio_fd2uuid(int fd) {
-  if (fd < 0 || (size_t)fd >= fio_data->capa)
+  if (fd < 0 || fio_fd_data_reserve(fd))
     return -1;
   if (!fd_data(fd).open) {
     fio_lock(&fd_data(fd).protocol_lock);
@@ -451,10 +942,10 @@ void fio_touch(intptr_t uuid) {
 
 /* public API. */
 fio_str_info_s fio_peer_addr(intptr_t uuid) {
-  if (fio_is_closed(uuid) || !uuid_data(uuid).addr_len)
+  if (fio_is_closed(uuid) || !uuid_cold(uuid).addr_len)
     return (fio_str_info_s){.data = NULL, .len = 0, .capa = 0};
-  return (fio_str_info_s){.data = (char *)uuid_data(uuid).addr,
-                          .len = uuid_data(uuid).addr_len,
+  return (fio_str_info_s){.data = (char *)uuid_cold(uuid).addr,
+                          .len = uuid_cold(uuid).addr_len,
                           .capa = 0};
 }
 
@@ -510,7 +1001,7 @@ void fio_uuid_link(intptr_t uuid, void *obj, void (*on_close)(void *obj)) {
   fio_lock(&uuid_data(uuid).sock_lock);
   if (!uuid_is_valid(uuid))
     goto locked_invalid;
-  fio_uuid_links_overwrite(&uuid_data(uuid).links, (uintptr_t)obj, on_close,
+  fio_uuid_links_overwrite(&uuid_cold(uuid).links, (uintptr_t)obj, on_close,
                            NULL);
   fio_unlock(&uuid_data(uuid).sock_lock);
   return;
@@ -530,7 +1021,7 @@ int fio_uuid_unlink(intptr_t uuid, void *obj) {
     goto locked_invalid;
   /* default object comparison is always true */
   int ret =
-      fio_uuid_links_remove(&uuid_data(uuid).links, (uintptr_t)obj, NULL, NULL);
+      fio_uuid_links_remove(&uuid_cold(uuid).links, (uintptr_t)obj, NULL, NULL);
   if (ret)
     errno = ENOTCONN;
   fio_unlock(&uuid_data(uuid).sock_lock);
@@ -647,11 +1138,19 @@ Suspending and renewing thread execution (signaling events)
 #define FIO_DEFER_THROTTLE_LIMIT 134217472UL
 #endif
 
+#if !defined(FIO_THREAD_FUTEX) && defined(__linux__) && defined(SYS_futex)
+/* Idle threads are parked on a `futex` rather than a per thread pipe. */
+#define FIO_THREAD_FUTEX 1
+#elif !defined(FIO_THREAD_FUTEX)
+#define FIO_THREAD_FUTEX 0
+#endif
+
 /**
- * The polling throttling model will use pipes to suspend and resume threads...
+ * The polling throttling model suspends idle threads until a task is scheduled
+ * (or for up to 5 seconds). On Linux threads are parked on a `futex`, elsewhere
+ * each thread polls a pipe of it's own.
  *
- * However, it seems the approach is currently broken, at least on macOS.
- * I don't know why.
+ * The pipe approach seems to be broken on macOS, so it isn't the default.
  *
  * If polling is disabled, the progressive throttling model will be used.
  *
@@ -659,9 +1158,88 @@ Suspending and renewing thread execution (signaling events)
  * progressive nano-sleep throttling system that is less exact.
  */
 #ifndef FIO_DEFER_THROTTLE_POLL
-#define FIO_DEFER_THROTTLE_POLL 0
+#define FIO_DEFER_THROTTLE_POLL FIO_THREAD_FUTEX
 #endif
 
+#if FIO_THREAD_FUTEX
+
+/*
+ * Parked threads wait for `seq` to change. Wakers only perform a system call
+ * when more threads are parked than were already woken, so a busy server
+ * signals for free.
+ *
+ * `state` holds the number of parked threads (low 32 bits) and the number of
+ * wake ups that weren't consumed yet (high 32 bits), so both are updated
+ * together.
+ */
+static struct {
+  uint32_t volatile seq;
+  uint64_t volatile state;
+} fio_thread_park;
+
+#define FIO_THREAD_PARKED(state) ((uint32_t)(state))
+#define FIO_THREAD_WAKING(state) ((uint32_t)((state) >> 32))
+
+FIO_FUNC inline void fio_thread_make_suspendable(void) {}
+
+FIO_FUNC inline void fio_thread_cleanup(void) {}
+
+/* suspend thread execution (might be resumed unexpectedly) */
+FIO_FUNC void fio_thread_suspend(void) {
+  const uint32_t seq = fio_thread_park.seq;
+  fio_atomic_add(&fio_thread_park.state, 1);
+  /* a task scheduled before `state` was updated might not have signaled */
+  if (!fio_defer_has_queue() && fio_is_running()) {
+    struct timespec timeout = {.tv_sec = 5};
+    fio_stats_add(thread_parks, 1);
+    syscall(SYS_futex, &fio_thread_park.seq, FUTEX_WAIT_PRIVATE, seq, &timeout,
+            NULL, 0);
+  }
+  /* leave, consuming a wake up (waking threads never exceed parked threads) */
+  uint64_t old, state;
+  do {
+    old = fio_thread_park.state;
+    uint64_t parked = FIO_THREAD_PARKED(old) - 1;
+    uint64_t waking = FIO_THREAD_WAKING(old);
+    if (waking)
+      --waking;
+    if (waking > parked)
+      waking = parked;
+    state = (waking << 32) | parked;
+  } while (!__sync_bool_compare_and_swap(&fio_thread_park.state, old, state));
+}
+
+/* wakes up to `count` parked threads */
+FIO_FUNC inline void fio_thread_wake(uint32_t count) {
+  uint64_t old;
+  /* orders the scheduled task before reading `state` */
+  __sync_synchronize();
+  do {
+    old = fio_thread_park.state;
+    const uint32_t idle = FIO_THREAD_PARKED(old) - FIO_THREAD_WAKING(old);
+    if (!idle)
+      return;
+    if (count > idle)
+      count = idle;
+  } while (!__sync_bool_compare_and_swap(&fio_thread_park.state, old,
+                                         old + ((uint64_t)count << 32)));
+  fio_atomic_add(&fio_thread_park.seq, 1);
+  fio_stats_add(thread_wakes, 1);
+  syscall(SYS_futex, &fio_thread_park.seq, FUTEX_WAKE_PRIVATE, (int)count,
+          NULL, NULL, 0);
+}
+
+#undef FIO_THREAD_PARKED
+#undef FIO_THREAD_WAKING
+
+/* wake up a single thread */
+FIO_FUNC void fio_thread_signal(void) { fio_thread_wake(1); }
+
+/* wake up all threads */
+FIO_FUNC void fio_thread_broadcast(void) { fio_thread_wake((uint32_t)-1); }
+
+#else /* FIO_THREAD_FUTEX */
+
 typedef struct fio_thread_queue_s {
   fio_ls_embd_s node;
   int fd_wait;   /* used for weaiting (read signal) */
@@ -744,13 +1322,16 @@ FIO_FUNC void fio_thread_broadcast(void) {
   }
 }
 
+#endif /* FIO_THREAD_FUTEX */
+
 static size_t fio_poll(void);
 /**
  * A thread entering this function should wait for new evennts.
  */
 static void fio_defer_thread_wait(void) {
 #if FIO_ENGINE_POLL
-  fio_poll();
+  const uint64_t start = fio_histogram_now();
+  fio_stats_poll(fio_poll(), start);
   return;
 #endif
   if (FIO_DEFER_THROTTLE_POLL) {
@@ -766,7 +1347,11 @@ static void fio_defer_thread_wait(void) {
   }
 }
 
+static void fio_defer_local_claim(void);
+static void fio_defer_local_release(void);
+
 static inline void fio_defer_on_thread_start(void) {
+  fio_defer_local_claim();
   if (FIO_DEFER_THROTTLE_POLL)
     fio_thread_make_suspendable();
 }
@@ -775,6 +1360,7 @@ static inline void fio_defer_thread_signal(void) {
     fio_thread_signal();
 }
 static inline void fio_defer_on_thread_end(void) {
+  fio_defer_local_release();
   if (FIO_DEFER_THROTTLE_POLL) {
     fio_thread_broadcast();
     fio_thread_cleanup();
@@ -817,23 +1403,45 @@ Section Start Marker
 
 ***************************************************************************** */
 
-#ifndef DEFER_QUEUE_BLOCK_COUNT
-#if UINTPTR_MAX <= 0xFFFFFFFF
-/* Almost a page of memory on most 32 bit machines: ((4096/4)-8)/3 */
-#define DEFER_QUEUE_BLOCK_COUNT 338
-#else
-/* Almost a page of memory on most 64 bit machines: ((4096/8)-8)/3 */
-#define DEFER_QUEUE_BLOCK_COUNT 168
-#endif
-#endif
-
 /* task node data */
 typedef struct {
   void (*func)(void *, void *);
   void *arg1;
   void *arg2;
+#if FIO_HISTOGRAMS
+  /* the time the task was first queued (see FIO_HISTOGRAM_QUEUE_WAIT) */
+  uint64_t queued;
+#endif
 } fio_defer_task_s;
 
+/* marks the time a task was first queued */
+static inline void fio_defer_task_stamp(fio_defer_task_s *task) {
+#if FIO_HISTOGRAMS
+  if (!task->queued)
+    task->queued = fio_monotonic_ns();
+#else
+  (void)task;
+#endif
+}
+
+/* performs a task, recording the time it waited in the queue */
+static inline void fio_defer_task_perform(fio_defer_task_s task) {
+#if FIO_HISTOGRAMS
+  fio_histogram_add(FIO_HISTOGRAM_QUEUE_WAIT,
+                    fio_monotonic_ns() - task.queued);
+#endif
+  task.func(task.arg1, task.arg2);
+}
+
+#ifndef DEFER_QUEUE_BLOCK_COUNT
+/*
+ * A page of memory (or almost), less the block's header (4 words), whatever the
+ * size of a task is (it grows when tasks are stamped for FIO_HISTOGRAMS).
+ */
+#define DEFER_QUEUE_BLOCK_COUNT                                                \
+  ((4096 - (sizeof(void *) << 2)) / sizeof(fio_defer_task_s))
+#endif
+
 /* task queue block */
 typedef struct fio_defer_queue_block_s fio_defer_queue_block_s;
 struct fio_defer_queue_block_s {
@@ -844,7 +1452,12 @@ struct fio_defer_queue_block_s {
   unsigned char state;
 };
 
-/* task queue object */
+#ifndef FIO_DEFER_QUEUE_SHARDS
+/* The number of independently locked shards per task queue (a power of 2) */
+#define FIO_DEFER_QUEUE_SHARDS 8
+#endif
+
+/* task queue object (a single shard) */
 typedef struct { /* a lock for the state machine, used for multi-threading
                     support */
   fio_lock_i lock;
@@ -856,20 +1469,49 @@ typedef struct { /* a lock for the state machine, used for multi-threading
   fio_defer_queue_block_s static_queue;
 } fio_task_queue_s;
 
-/* the state machine - this holds all the data about the task queue and pool */
-static fio_task_queue_s task_queue_normal = {
-    .reader = &task_queue_normal.static_queue,
-    .writer = &task_queue_normal.static_queue};
+/*
+ * the state machine - this holds all the data about the task queue and pool.
+ *
+ * Each queue is split into shards, each with it's own lock. Threads push tasks
+ * to their own shard and pop tasks from any shard (round robin), so producers
+ * and consumers rarely compete over the same lock.
+ *
+ * A shard's `reader` and `writer` point at it's `static_queue` once it's used.
+ */
+static fio_task_queue_s task_queue_normal[FIO_DEFER_QUEUE_SHARDS];
+
+static fio_task_queue_s task_queue_urgent[FIO_DEFER_QUEUE_SHARDS];
+
+/* tasks postponed to the next reactor cycle (connections over budget) */
+static fio_task_queue_s task_queue_postponed;
+
+/* the shard used by the current thread (0 == unassigned) */
+static __thread size_t fio_defer_shard_id;
+/* the shard the current thread will try to pop from first */
+static __thread size_t fio_defer_shard_cursor;
+
+/* returns the current thread's shard index */
+static inline size_t fio_defer_shard(void) {
+  static size_t counter = 0;
+  if (!fio_defer_shard_id) {
+    fio_defer_shard_id = fio_atomic_add(&counter, 1);
+    fio_defer_shard_cursor = fio_defer_shard_id;
+  }
+  return fio_defer_shard_id & (FIO_DEFER_QUEUE_SHARDS - 1);
+}
 
-static fio_task_queue_s task_queue_urgent = {
-    .reader = &task_queue_urgent.static_queue,
-    .writer = &task_queue_urgent.static_queue};
+/* tests if a shard is empty (without locking, might be inaccurate) */
+static inline int fio_defer_queue_is_empty(fio_task_queue_s *queue) {
+  return !queue->reader || (queue->reader == queue->writer &&
+                            queue->reader->write == queue->reader->read &&
+                            !queue->reader->state);
+}
 
 /* *****************************************************************************
 Internal Task API
 ***************************************************************************** */
 
-#if DEBUG
+/* queue block allocations are rare, so they're always counted (`fio_stats`) */
 static size_t fio_defer_count_alloc, fio_defer_count_dealloc;
 #define COUNT_ALLOC fio_atomic_add(&fio_defer_count_alloc, 1)
 #define COUNT_DEALLOC fio_atomic_add(&fio_defer_count_dealloc, 1)
@@ -877,16 +1519,15 @@ static size_t fio_defer_count_alloc, fio_defer_count_dealloc;
   do {                                                                         \
     fio_defer_count_alloc = fio_defer_count_dealloc = 0;                       \
   } while (0)
-#else
-#define COUNT_ALLOC
-#define COUNT_DEALLOC
-#define COUNT_RESET
-#endif
 
 static inline void fio_defer_push_task_fn(fio_defer_task_s task,
                                           fio_task_queue_s *queue) {
+  fio_defer_task_stamp(&task);
   fio_lock(&queue->lock);
 
+  if (!queue->writer)
+    queue->reader = queue->writer = &queue->static_queue;
+
   /* test if full */
   if (queue->writer->state && queue->writer->write == queue->writer->read) {
     /* return to static buffer or allocate new buffer */
@@ -924,7 +1565,7 @@ critical_error:
   do {                                                                         \
     fio_defer_push_task_fn(                                                    \
         (fio_defer_task_s){.func = func_, .arg1 = arg1_, .arg2 = arg2_},       \
-        &task_queue_normal);                                                   \
+        task_queue_normal + fio_defer_shard());                                \
     fio_defer_thread_signal();                                                 \
   } while (0)
 
@@ -932,20 +1573,21 @@ critical_error:
 #define fio_defer_push_urgent(func_, arg1_, arg2_)                             \
   fio_defer_push_task_fn(                                                      \
       (fio_defer_task_s){.func = func_, .arg1 = arg1_, .arg2 = arg2_},         \
-      &task_queue_urgent)
+      task_queue_urgent + fio_defer_shard())
 #else
 #define fio_defer_push_urgent(func_, arg1_, arg2_)                             \
   fio_defer_push_task(func_, arg1_, arg2_)
 #endif
 
-static inline fio_defer_task_s fio_defer_pop_task(fio_task_queue_s *queue) {
+/* pops a task from a locked shard, unlocking the shard */
+static inline fio_defer_task_s
+fio_defer_pop_task_locked(fio_task_queue_s *queue) {
   fio_defer_task_s ret = (fio_defer_task_s){.func = NULL};
   fio_defer_queue_block_s *to_free = NULL;
-  /* lock the state machine, grab/create a task and place it at the tail */
-  fio_lock(&queue->lock);
 
   /* empty? */
-  if (queue->reader->write == queue->reader->read && !queue->reader->state)
+  if (!queue->reader ||
+      (queue->reader->write == queue->reader->read && !queue->reader->state))
     goto finish;
   /* collect task */
   ret = queue->reader->tasks[queue->reader->read++];
@@ -984,8 +1626,46 @@ finish:
   return ret;
 }
 
-/* same as fio_defer_clear_queue , just inlined */
-static inline void fio_defer_clear_tasks_for_queue(fio_task_queue_s *queue) {
+/* pops a task from any of the queue's shards (returns an empty task if none) */
+static inline fio_defer_task_s fio_defer_pop_task(fio_task_queue_s *queues) {
+  fio_defer_task_s ret = (fio_defer_task_s){.func = NULL};
+  size_t busy = 0;
+  fio_defer_shard(); /* initializes the cursor */
+  const size_t start = fio_defer_shard_cursor;
+  /* first pass, skip any shard that's being accessed by another thread */
+  for (size_t i = 0; i < FIO_DEFER_QUEUE_SHARDS; ++i) {
+    fio_task_queue_s *queue =
+        queues + ((start + i) & (FIO_DEFER_QUEUE_SHARDS - 1));
+    if (fio_defer_queue_is_empty(queue))
+      continue;
+    if (fio_trylock(&queue->lock)) {
+      ++busy;
+      continue;
+    }
+    ret = fio_defer_pop_task_locked(queue);
+    if (ret.func)
+      goto found;
+  }
+  /* second pass, wait for busy shards that might hold tasks */
+  for (size_t i = 0; busy && i < FIO_DEFER_QUEUE_SHARDS; ++i) {
+    fio_task_queue_s *queue =
+        queues + ((start + i) & (FIO_DEFER_QUEUE_SHARDS - 1));
+    if (fio_defer_queue_is_empty(queue))
+      continue;
+    fio_lock(&queue->lock);
+    ret = fio_defer_pop_task_locked(queue);
+    if (ret.func)
+      goto found;
+  }
+  return ret;
+found:
+  /* round robin, so a busy shard can't starve the others */
+  ++fio_defer_shard_cursor;
+  return ret;
+}
+
+/* clears a single shard */
+static inline void fio_defer_clear_tasks_for_shard(fio_task_queue_s *queue) {
   fio_lock(&queue->lock);
   while (queue->reader) {
     fio_defer_queue_block_s *tmp = queue->reader;
@@ -1000,29 +1680,244 @@ static inline void fio_defer_clear_tasks_for_queue(fio_task_queue_s *queue) {
   fio_unlock(&queue->lock);
 }
 
-/**
- * Performs a single task from the queue, returning -1 if the queue was empty.
- */
-static inline int
-fio_defer_perform_single_task_for_queue(fio_task_queue_s *queue) {
-  fio_defer_task_s task = fio_defer_pop_task(queue);
-  if (!task.func)
-    return -1;
-  task.func(task.arg1, task.arg2);
-  return 0;
+/* same as fio_defer_clear_queue , just inlined */
+static inline void fio_defer_clear_tasks_for_queue(fio_task_queue_s *queues) {
+  for (size_t i = 0; i < FIO_DEFER_QUEUE_SHARDS; ++i) {
+    fio_defer_clear_tasks_for_shard(queues + i);
+  }
+}
+
+/* moves postponed tasks to the end of the (normal) task queue */
+static void fio_defer_release_postponed(void) {
+  if (fio_defer_queue_is_empty(&task_queue_postponed))
+    return;
+  for (;;) {
+    fio_lock(&task_queue_postponed.lock);
+    fio_defer_task_s task = fio_defer_pop_task_locked(&task_queue_postponed);
+    if (!task.func)
+      break;
+    fio_defer_push_task_fn(task, task_queue_normal + fio_defer_shard());
+  }
+  fio_defer_thread_signal();
+}
+
+/**
+ * Performs a single task from the queue, returning -1 if the queue was empty.
+ */
+static inline int
+fio_defer_perform_single_task_for_queue(fio_task_queue_s *queues) {
+  fio_defer_task_s task = fio_defer_pop_task(queues);
+  if (!task.func)
+    return -1;
+  fio_defer_task_perform(task);
+  return 0;
+}
+
+/* *****************************************************************************
+Thread Local Task Queues (work stealing)
+***************************************************************************** */
+
+#ifndef FIO_DEFER_LOCAL_QUEUE_SIZE
+/* The capacity of a pool thread's local task queue (a power of 2) */
+#define FIO_DEFER_LOCAL_QUEUE_SIZE 128
+#endif
+
+#ifndef FIO_DEFER_LOCAL_QUEUE_MAX
+/* The maximum number of pool threads with a local task queue */
+#define FIO_DEFER_LOCAL_QUEUE_MAX 64
+#endif
+
+#ifndef FIO_DEFER_LOCAL_BATCH
+/* Local tasks performed in a row before a shared queue task is performed */
+#define FIO_DEFER_LOCAL_BATCH 16
+#endif
+
+#ifndef FIO_DEFER_LOCAL_SIGNAL
+/* Local tasks waiting before a (parked) thread is woken to steal them */
+#define FIO_DEFER_LOCAL_SIGNAL 8
+#endif
+
+/*
+ * Tasks deferred (`fio_defer`) by a pool thread are placed in the thread's local
+ * queue. The owner performs it's tasks before the shared queue's tasks (the data
+ * is still warm in the CPU cache), while idle threads steal tasks. Tasks are
+ * always taken oldest first (FIFO).
+ *
+ * Local queues are statically allocated, so a thief never accesses a queue that
+ * was released.
+ */
+typedef struct {
+  /* protects the queue (the owner rarely competes with a thief) */
+  fio_lock_i lock;
+  /* marks the queue as owned by a thread */
+  fio_lock_i owned;
+  /* the next task to be performed or stolen (the oldest task) */
+  size_t head;
+  /* the next free slot (the owner pushes tasks here) */
+  size_t tail;
+  fio_defer_task_s tasks[FIO_DEFER_LOCAL_QUEUE_SIZE];
+} fio_defer_local_s;
+
+static fio_defer_local_s fio_defer_locals[FIO_DEFER_LOCAL_QUEUE_MAX];
+/* the number of local queues that might be in use (high water mark) */
+static size_t fio_defer_locals_count;
+static fio_lock_i fio_defer_locals_lock = FIO_LOCK_INIT;
+/* the current thread's local queue (if any) */
+static __thread fio_defer_local_s *fio_defer_local;
+
+/* claims a local task queue for the current (pool) thread */
+static void fio_defer_local_claim(void) {
+  if (fio_defer_local)
+    return;
+  fio_lock(&fio_defer_locals_lock);
+  for (size_t i = 0; i < FIO_DEFER_LOCAL_QUEUE_MAX; ++i) {
+    if (fio_trylock(&fio_defer_locals[i].owned))
+      continue;
+    fio_defer_local = fio_defer_locals + i;
+    fio_defer_local->head = fio_defer_local->tail = 0;
+    if (fio_defer_locals_count <= i)
+      fio_defer_locals_count = i + 1;
+    break;
+  }
+  fio_unlock(&fio_defer_locals_lock);
+}
+
+/**
+ * Pushes a task to the current thread's local queue, returning the number of
+ * tasks waiting in the queue (or 0 if the queue is full).
+ */
+static inline size_t fio_defer_local_push(fio_defer_task_s task) {
+  fio_defer_local_s *local = fio_defer_local;
+  size_t ret = 0;
+  fio_defer_task_stamp(&task);
+  fio_lock(&local->lock);
+  if (local->tail - local->head < FIO_DEFER_LOCAL_QUEUE_SIZE) {
+    local->tasks[local->tail & (FIO_DEFER_LOCAL_QUEUE_SIZE - 1)] = task;
+    ++local->tail;
+    ret = local->tail - local->head;
+  }
+  fio_unlock(&local->lock);
+  return ret;
+}
+
+/* pops the oldest task from the current thread's local queue (FIFO) */
+static inline fio_defer_task_s fio_defer_local_pop(void) {
+  fio_defer_local_s *local = fio_defer_local;
+  fio_defer_task_s ret = (fio_defer_task_s){.func = NULL};
+  if (!local || local->tail == local->head)
+    return ret;
+  fio_lock(&local->lock);
+  if (local->tail != local->head) {
+    ret = local->tasks[local->head & (FIO_DEFER_LOCAL_QUEUE_SIZE - 1)];
+    ++local->head;
+  }
+  fio_unlock(&local->lock);
+  return ret;
+}
+
+/* steals the oldest task from another thread's local queue */
+static inline fio_defer_task_s fio_defer_local_steal(void) {
+  fio_defer_task_s ret = (fio_defer_task_s){.func = NULL};
+  const size_t count = fio_defer_locals_count;
+  const size_t start =
+      fio_defer_local ? (size_t)(fio_defer_local - fio_defer_locals) + 1 : 0;
+  for (size_t i = 0; i < count; ++i) {
+    fio_defer_local_s *victim = fio_defer_locals + ((start + i) % count);
+    if (victim == fio_defer_local || victim->tail == victim->head ||
+        fio_trylock(&victim->lock))
+      continue;
+    if (victim->tail != victim->head) {
+      ret = victim->tasks[victim->head & (FIO_DEFER_LOCAL_QUEUE_SIZE - 1)];
+      ++victim->head;
+    }
+    fio_unlock(&victim->lock);
+    if (ret.func)
+      break;
+  }
+  return ret;
+}
+
+/* tests if any local queue holds tasks (without locking) */
+static inline int fio_defer_local_any(void) {
+  for (size_t i = 0; i < fio_defer_locals_count; ++i) {
+    if (fio_defer_locals[i].tail != fio_defer_locals[i].head)
+      return 1;
+  }
+  return 0;
+}
+
+/* releases the current thread's local queue, moving tasks to the shared queue */
+static void fio_defer_local_release(void) {
+  fio_defer_local_s *local = fio_defer_local;
+  if (!local)
+    return;
+  fio_lock(&local->lock);
+  while (local->head != local->tail) {
+    fio_defer_push_task_fn(
+        local->tasks[local->head & (FIO_DEFER_LOCAL_QUEUE_SIZE - 1)],
+        task_queue_normal + fio_defer_shard());
+    ++local->head;
+  }
+  fio_unlock(&local->lock);
+  fio_defer_local = NULL;
+  fio_unlock(&local->owned);
+}
+
+/* clears all the local queues (tasks are dropped) */
+static void fio_defer_local_clear(void) {
+  for (size_t i = 0; i < fio_defer_locals_count; ++i) {
+    fio_lock(&fio_defer_locals[i].lock);
+    fio_defer_locals[i].head = fio_defer_locals[i].tail;
+    fio_unlock(&fio_defer_locals[i].lock);
+  }
+}
+
+/* performs a task from the thread's local queue, returning -1 if empty */
+static inline int fio_defer_perform_single_local_task(void) {
+  fio_defer_task_s task = fio_defer_local_pop();
+  if (!task.func)
+    return -1;
+  fio_defer_task_perform(task);
+  return 0;
+}
+
+/* steals and performs another thread's task, returning -1 if none was found */
+static inline int fio_defer_perform_single_stolen_task(void) {
+  fio_defer_task_s task = fio_defer_local_steal();
+  if (!task.func)
+    return -1;
+  fio_defer_task_perform(task);
+  return 0;
 }
 
 static inline void fio_defer_clear_tasks(void) {
-  fio_defer_clear_tasks_for_queue(&task_queue_normal);
+  fio_defer_local_clear();
+  fio_defer_clear_tasks_for_shard(&task_queue_postponed);
+  fio_defer_clear_tasks_for_queue(task_queue_normal);
 #if FIO_USE_URGENT_QUEUE
-  fio_defer_clear_tasks_for_queue(&task_queue_urgent);
+  fio_defer_clear_tasks_for_queue(task_queue_urgent);
 #endif
 }
 
 static void fio_defer_on_fork(void) {
-  task_queue_normal.lock = FIO_LOCK_INIT;
+  /* only the forking thread survives */
+  for (size_t i = 0; i < FIO_DEFER_LOCAL_QUEUE_MAX; ++i) {
+    fio_defer_locals[i].lock = FIO_LOCK_INIT;
+    fio_defer_locals[i].owned = FIO_LOCK_INIT;
+    fio_defer_locals[i].head = fio_defer_locals[i].tail = 0;
+  }
+  fio_defer_locals_count = 0;
+  fio_defer_locals_lock = FIO_LOCK_INIT;
+  fio_defer_local = NULL;
+  task_queue_postponed.lock = FIO_LOCK_INIT;
+  for (size_t i = 0; i < FIO_DEFER_QUEUE_SHARDS; ++i) {
+    task_queue_normal[i].lock = FIO_LOCK_INIT;
 #if FIO_USE_URGENT_QUEUE
-  task_queue_urgent.lock = FIO_LOCK_INIT;
+    task_queue_urgent[i].lock = FIO_LOCK_INIT;
+#endif
+  }
+#if FIO_THREAD_FUTEX
+  fio_thread_park.state = 0;
 #endif
 }
 
@@ -1035,6 +1930,16 @@ int fio_defer(void (*func)(void *, void *), void *arg1, void *arg2) {
   /* must have a task to defer */
   if (!func)
     goto call_error;
+  if (fio_defer_local) {
+    /* pool threads keep their own tasks (idle threads might steal them) */
+    const size_t waiting = fio_defer_local_push(
+        (fio_defer_task_s){.func = func, .arg1 = arg1, .arg2 = arg2});
+    if (waiting) {
+      if (waiting > FIO_DEFER_LOCAL_SIGNAL)
+        fio_defer_thread_signal();
+      return 0;
+    }
+  }
   fio_defer_push_task(func, arg1, arg2);
   return 0;
 
@@ -1044,14 +1949,25 @@ call_error:
 
 /** Performs all deferred functions until the queue had been depleted. */
 void fio_defer_perform(void) {
+  size_t local = 0;
+  for (;;) {
 #if FIO_USE_URGENT_QUEUE
-  while (fio_defer_perform_single_task_for_queue(&task_queue_urgent) == 0 ||
-         fio_defer_perform_single_task_for_queue(&task_queue_normal) == 0)
-    ;
-#else
-  while (fio_defer_perform_single_task_for_queue(&task_queue_normal) == 0)
-    ;
+    if (fio_defer_perform_single_task_for_queue(task_queue_urgent) == 0)
+      continue;
 #endif
+    /* local tasks first, but let a shared task run every once in a while */
+    if (local < FIO_DEFER_LOCAL_BATCH &&
+        fio_defer_perform_single_local_task() == 0) {
+      ++local;
+      continue;
+    }
+    local = 0;
+    if (fio_defer_perform_single_task_for_queue(task_queue_normal) == 0 ||
+        fio_defer_perform_single_local_task() == 0 ||
+        fio_defer_perform_single_stolen_task() == 0)
+      continue;
+    break;
+  }
   //   for (;;) {
   // #if FIO_USE_URGENT_QUEUE
   //     fio_defer_task_s task = fio_defer_pop_task(&task_queue_urgent);
@@ -1068,59 +1984,196 @@ void fio_defer_perform(void) {
 
 /** Returns true if there are deferred functions waiting for execution. */
 int fio_defer_has_queue(void) {
+  for (size_t i = 0; i < FIO_DEFER_QUEUE_SHARDS; ++i) {
 #if FIO_USE_URGENT_QUEUE
-  return task_queue_urgent.reader != task_queue_urgent.writer ||
-         task_queue_urgent.reader->write != task_queue_urgent.reader->read ||
-         task_queue_normal.reader != task_queue_normal.writer ||
-         task_queue_normal.reader->write != task_queue_normal.reader->read;
-#else
-  return task_queue_normal.reader != task_queue_normal.writer ||
-         task_queue_normal.reader->write != task_queue_normal.reader->read;
+    if (!fio_defer_queue_is_empty(task_queue_urgent + i))
+      return 1;
 #endif
+    if (!fio_defer_queue_is_empty(task_queue_normal + i))
+      return 1;
+  }
+  return fio_defer_local_any();
 }
 
 /** Clears the queue. */
 void fio_defer_clear_queue(void) { fio_defer_clear_tasks(); }
 
+#ifndef FIO_DEFER_POOL_GROW_DELAY
+/* Milliseconds of queue pressure before an adaptive thread pool grows */
+#define FIO_DEFER_POOL_GROW_DELAY 10
+#endif
+
+#ifndef FIO_DEFER_POOL_IDLE_TIMEOUT
+/* Seconds an extra thread may idle before an adaptive thread pool retires it */
+#define FIO_DEFER_POOL_IDLE_TIMEOUT 30
+#endif
+
+/* thread pool type (adaptive pools have more slots than `min_count`) */
+typedef struct {
+  size_t thread_count; /* thread slots */
+  size_t min_count;    /* threads that are never retired */
+  size_t live;         /* running (non retired) threads */
+  size_t idle;         /* threads waiting for tasks */
+  size_t grow_delay;   /* milliseconds */
+  size_t idle_timeout; /* milliseconds */
+  fio_lock_i lock;
+  struct {
+    void *thread;
+    volatile uint8_t retired;
+  } threads[];
+} fio_defer_thread_pool_s;
+
+/* the adaptive thread pool (if any), set before it's threads are spawned */
+static fio_defer_thread_pool_s *volatile fio_defer_pool_adaptive;
+
+/* a monotonic millisecond clock for the adaptive thread pool */
+static inline size_t fio_defer_pool_now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return ((size_t)t.tv_sec * 1000) + ((size_t)t.tv_nsec / 1000000);
+}
+
+/* marks a thread as retired, unless the pool is at it's minimal size */
+static int fio_defer_pool_retire(fio_defer_thread_pool_s *pool, size_t index) {
+  int ret = 0;
+  fio_lock(&pool->lock);
+  if (pool->live > pool->min_count) {
+    --pool->live;
+    pool->threads[index].retired = 1;
+    ret = 1;
+  }
+  fio_unlock(&pool->lock);
+  return ret;
+}
+
+static void fio_buffer_cache_flush(void);
+
 /* Thread pool task */
 static void *fio_defer_cycle(void *ignr) {
+  fio_defer_thread_pool_s *pool = fio_defer_pool_adaptive;
+  size_t idle_since = 0;
+  fio_affinity_pin_thread((size_t)ignr);
   fio_defer_on_thread_start();
   for (;;) {
+    if (pool && fio_defer_has_queue())
+      idle_since = 0;
     fio_defer_perform();
     if (!fio_is_running())
       break;
+    if (!pool) {
+      fio_defer_thread_wait();
+      continue;
+    }
+    /* adaptive pools retire threads after they idle for a while */
+    if (!idle_since)
+      idle_since = fio_defer_pool_now();
+    else if (fio_defer_pool_now() - idle_since >= pool->idle_timeout &&
+             fio_defer_pool_retire(pool, (size_t)ignr))
+      break;
+    fio_atomic_add(&pool->idle, 1);
     fio_defer_thread_wait();
+    fio_atomic_sub(&pool->idle, 1);
   }
+  fio_buffer_cache_flush();
   fio_defer_on_thread_end();
   return ignr;
 }
 
-/* thread pool type */
-typedef struct {
-  size_t thread_count;
-  void *threads[];
-} fio_defer_thread_pool_s;
+/* spawns an extra thread for an adaptive pool (the supervisor only) */
+static void fio_defer_thread_pool_grow(fio_defer_thread_pool_s *pool) {
+  for (size_t i = 0; i < pool->thread_count; ++i) {
+    if (pool->threads[i].thread)
+      continue;
+    fio_lock(&pool->lock);
+    ++pool->live;
+    pool->threads[i].retired = 0;
+    fio_unlock(&pool->lock);
+    pool->threads[i].thread = fio_thread_new(fio_defer_cycle, (void *)i);
+    if (!pool->threads[i].thread) {
+      fio_lock(&pool->lock);
+      --pool->live;
+      fio_unlock(&pool->lock);
+      FIO_LOG_WARNING("(%d) couldn't grow the thread pool.", (int)getpid());
+      return;
+    }
+    FIO_LOG_DEBUG("(%d) thread pool grew to %zu threads", (int)getpid(),
+                  pool->live);
+    return;
+  }
+}
+
+/*
+ * Supervises an adaptive pool until shutdown - joins retired threads and grows
+ * the pool while tasks are left waiting with all the threads busy.
+ */
+static void fio_defer_thread_pool_supervise(fio_defer_thread_pool_s *pool) {
+  size_t busy_since = 0;
+  const size_t tick = (pool->grow_delay >> 1) + 1;
+  while (fio_is_running()) {
+    fio_throttle_thread(tick * 1000000UL);
+    for (size_t i = 0; i < pool->thread_count; ++i) {
+      if (pool->threads[i].thread && pool->threads[i].retired) {
+        fio_thread_join(pool->threads[i].thread);
+        pool->threads[i].thread = NULL;
+        FIO_LOG_DEBUG("(%d) thread pool shrunk to %zu threads", (int)getpid(),
+                      pool->live);
+      }
+    }
+    if (pool->idle || pool->live >= pool->thread_count ||
+        !fio_defer_has_queue()) {
+      busy_since = 0;
+      continue;
+    }
+    const size_t now = fio_defer_pool_now();
+    if (!busy_since) {
+      busy_since = now;
+      continue;
+    }
+    if (now - busy_since < pool->grow_delay)
+      continue;
+    busy_since = now;
+    fio_defer_thread_pool_grow(pool);
+  }
+}
 
-/* joins a thread pool */
+/* joins a thread pool (supervising adaptive pools until shutdown) */
 static void fio_defer_thread_pool_join(fio_defer_thread_pool_s *pool) {
+  if (!pool)
+    return;
+  if (pool->min_count < pool->thread_count)
+    fio_defer_thread_pool_supervise(pool);
   for (size_t i = 0; i < pool->thread_count; ++i) {
-    fio_thread_join(pool->threads[i]);
+    if (pool->threads[i].thread)
+      fio_thread_join(pool->threads[i].thread);
   }
+  if (fio_defer_pool_adaptive == pool)
+    fio_defer_pool_adaptive = NULL;
   free(pool);
 }
 
-/* creates a thread pool */
-static fio_defer_thread_pool_s *fio_defer_thread_pool_new(size_t count) {
+/* creates a thread pool with `count` threads and room to grow up to `max` */
+static fio_defer_thread_pool_s *
+fio_defer_thread_pool_create(size_t count, size_t max, void *(*task)(void *)) {
   if (!count)
     count = 1;
+  if (max < count)
+    max = count;
   fio_defer_thread_pool_s *pool =
-      malloc(sizeof(*pool) + (count * sizeof(void *)));
+      calloc(sizeof(*pool) + (max * sizeof(pool->threads[0])), 1);
   FIO_ASSERT_ALLOC(pool);
-  pool->thread_count = count;
+  pool->thread_count = max;
+  pool->min_count = count;
+  pool->live = count;
+  pool->lock = FIO_LOCK_INIT;
+  if (max > count) {
+    pool->grow_delay = fio_data->grow_delay;
+    pool->idle_timeout = (size_t)fio_data->idle_timeout * 1000;
+    fio_defer_pool_adaptive = pool;
+  }
   for (size_t i = 0; i < count; ++i) {
-    pool->threads[i] = fio_thread_new(fio_defer_cycle, NULL);
-    if (!pool->threads[i]) {
-      pool->thread_count = i;
+    pool->threads[i].thread = fio_thread_new(task, (void *)i);
+    if (!pool->threads[i].thread) {
+      pool->thread_count = pool->min_count = i;
       goto error;
     }
   }
@@ -1132,6 +2185,18 @@ error:
   return NULL;
 }
 
+/* creates a thread pool, each thread's task receives the thread's index */
+static fio_defer_thread_pool_s *
+fio_defer_thread_pool_new2(size_t count, void *(*task)(void *)) {
+  return fio_defer_thread_pool_create(count, count, task);
+}
+
+/* creates a thread pool (adaptive, if `fio_start` was given `max_threads`) */
+static fio_defer_thread_pool_s *fio_defer_thread_pool_new(size_t count) {
+  return fio_defer_thread_pool_create(count, fio_data->max_threads,
+                                      fio_defer_cycle);
+}
+
 /* *****************************************************************************
 Section Start Marker
 
@@ -1156,137 +2221,264 @@ Section Start Marker
 
 ***************************************************************************** */
 
-typedef struct {
+/*
+ * Timers are stored in a hashed hierarchical timing wheel (millisecond ticks),
+ * so adding, rescheduling and canceling a timer is O(1).
+ *
+ * Timers that are due within 256ms are placed in the lowest level, where every
+ * slot is a single tick. Timers that are due later are placed in higher levels
+ * (every slot spanning 256 times the ticks of the lower level slot) and moved
+ * ("cascaded") to a lower level when the wheel reaches their slot.
+ *
+ * Timers that are due near or beyond the wheel's span (2^32 ms, ~49.7 days)
+ * are placed in the highest level slot that cascades last and are re-placed
+ * when cascaded, until they are within the wheel's span.
+ */
+
+#define FIO_TIMER_WHEEL_BITS 8
+#define FIO_TIMER_WHEEL_SLOTS (1 << FIO_TIMER_WHEEL_BITS)
+#define FIO_TIMER_WHEEL_MASK (FIO_TIMER_WHEEL_SLOTS - 1)
+#define FIO_TIMER_WHEEL_LEVELS 4
+#define FIO_TIMER_WHEEL_SPAN                                                   \
+  (1ULL << (FIO_TIMER_WHEEL_BITS * FIO_TIMER_WHEEL_LEVELS))
+
+/* timer states */
+enum {
+  FIO_TIMER_WAITING = 0, /* placed in the timing wheel */
+  FIO_TIMER_SCHEDULED,   /* placed in the task queue (or running) */
+  FIO_TIMER_CANCELED,    /* canceled while scheduled */
+};
+
+struct fio_timer_s {
   fio_ls_embd_s node;
-  struct timespec due;
+  uint64_t due;    /* in ms */
   size_t interval; /*in ms */
   size_t repetitions;
   void (*task)(void *);
   void *arg;
   void (*on_finish)(void *);
-} fio_timer_s;
+  uint8_t state;
+  uint8_t level; /* the timing wheel level (while waiting) */
+};
 
-static fio_ls_embd_s fio_timers = FIO_LS_INIT(fio_timers);
+static struct {
+  fio_ls_embd_s slots[FIO_TIMER_WHEEL_LEVELS][FIO_TIMER_WHEEL_SLOTS];
+  /* the number of timers in each level */
+  size_t count[FIO_TIMER_WHEEL_LEVELS];
+  /* the next tick (in ms) to be processed */
+  uint64_t current;
+  uint8_t initialized;
+} fio_timer_wheel;
 
-static fio_lock_i fio_timer_lock = FIO_LOCK_INIT;
+static fio_mutex_i fio_timer_lock = FIO_MUTEX_INIT;
 
 /** Marks the current time as facil.io's cycle time */
 static inline void fio_mark_time(void) {
   clock_gettime(CLOCK_REALTIME, &fio_data->last_cycle);
 }
 
-/** Calculates the due time for a task, given it's interval */
-static struct timespec fio_timer_calc_due(size_t interval) {
+/** Returns facil.io's cycle time in milliseconds */
+static inline uint64_t fio_timer_now(void) {
   struct timespec now = fio_last_tick();
-  if (interval >= 1000) {
-    unsigned long long secs = interval / 1000;
-    now.tv_sec += secs;
-    interval -= secs * 1000;
+  return ((uint64_t)now.tv_sec * 1000) + ((uint64_t)now.tv_nsec / 1000000);
+}
+
+/** Returns the total number of timers in the timing wheel. */
+static inline size_t fio_timer_count_unsafe(void) {
+  size_t count = 0;
+  for (size_t i = 0; i < FIO_TIMER_WHEEL_LEVELS; ++i)
+    count += fio_timer_wheel.count[i];
+  return count;
+}
+
+/** Places a timer in the timing wheel (the lock must be held). */
+static void fio_timer_add_unsafe(fio_timer_s *timer) {
+  if (timer->due < fio_timer_wheel.current)
+    timer->due = fio_timer_wheel.current;
+  uint64_t delta = timer->due - fio_timer_wheel.current;
+  uint64_t due = timer->due;
+  if (delta >= FIO_TIMER_WHEEL_SPAN - FIO_TIMER_WHEEL_SPAN / 256) {
+    /* beyond the wheel - never alias the slot that's cascading (if any) */
+    due = fio_timer_wheel.current + FIO_TIMER_WHEEL_SPAN -
+          (FIO_TIMER_WHEEL_SPAN / 256);
+    delta = due - fio_timer_wheel.current;
+  }
+  size_t level = 0;
+  while (level + 1 < FIO_TIMER_WHEEL_LEVELS &&
+         delta >= (1ULL << (FIO_TIMER_WHEEL_BITS * (level + 1))))
+    ++level;
+  const size_t slot =
+      (due >> (FIO_TIMER_WHEEL_BITS * level)) & FIO_TIMER_WHEEL_MASK;
+  timer->state = FIO_TIMER_WAITING;
+  timer->level = (uint8_t)level;
+  fio_ls_embd_push(&fio_timer_wheel.slots[level][slot], &timer->node);
+  ++fio_timer_wheel.count[level];
+}
+
+/** Places a new (or rescheduled) timer in the wheel (lock must be held). */
+static void fio_timer_insert_unsafe(fio_timer_s *timer) {
+  if (!fio_timer_wheel.initialized) {
+    for (size_t i = 0; i < FIO_TIMER_WHEEL_LEVELS; ++i) {
+      for (size_t j = 0; j < FIO_TIMER_WHEEL_SLOTS; ++j) {
+        fio_timer_wheel.slots[i][j] =
+            (fio_ls_embd_s)FIO_LS_INIT(fio_timer_wheel.slots[i][j]);
+      }
+    }
+    fio_timer_wheel.initialized = 1;
   }
-  now.tv_nsec += (interval * 1000000UL);
-  if (now.tv_nsec >= 1000000000L) {
-    now.tv_nsec -= 1000000000L;
-    now.tv_sec += 1;
+  if (!fio_timer_count_unsafe()) {
+    /* nothing to process, (re)align the wheel with the clock */
+    fio_timer_wheel.current = fio_timer_now();
   }
-  return now;
+  fio_timer_add_unsafe(timer);
 }
 
 /** Returns the number of miliseconds until the next event, up to FIO_POLL_TICK
  */
 static size_t fio_timer_calc_first_interval(void) {
-  if (fio_defer_has_queue())
+  if (fio_defer_has_queue() || !fio_defer_queue_is_empty(&task_queue_postponed))
     return 0;
-  if (fio_ls_embd_is_empty(&fio_timers)) {
-    return FIO_POLL_TICK;
+  const uint64_t now = fio_timer_now();
+  uint64_t due = now + FIO_POLL_TICK;
+  fio_mutex_lock(&fio_timer_lock);
+  for (size_t level = 1; level < FIO_TIMER_WHEEL_LEVELS; ++level) {
+    /* the nearest higher level slot holds the nearest cascading timers */
+    if (!fio_timer_wheel.count[level])
+      continue;
+    const size_t shift = FIO_TIMER_WHEEL_BITS * level;
+    for (uint64_t i = (fio_timer_wheel.current >> shift) + 1;
+         i <= (fio_timer_wheel.current >> shift) + FIO_TIMER_WHEEL_SLOTS;
+         ++i) {
+      fio_ls_embd_s *slot =
+          fio_timer_wheel.slots[level] + (i & FIO_TIMER_WHEEL_MASK);
+      if (!fio_ls_embd_any(slot))
+        continue;
+      FIO_LS_EMBD_FOR(slot, node) {
+        fio_timer_s *t = FIO_LS_EMBD_OBJ(fio_timer_s, node, node);
+        if (t->due < due)
+          due = t->due;
+      }
+      break;
+    }
+    break;
   }
-  struct timespec now = fio_last_tick();
-  struct timespec due =
-      FIO_LS_EMBD_OBJ(fio_timer_s, node, fio_timers.next)->due;
-  if (due.tv_sec < now.tv_sec ||
-      (due.tv_sec == now.tv_sec && due.tv_nsec <= now.tv_nsec))
-    return 0;
-  size_t interval = 1000L * (due.tv_sec - now.tv_sec);
-  if (due.tv_nsec >= now.tv_nsec) {
-    interval += (due.tv_nsec - now.tv_nsec) / 1000000L;
-  } else {
-    interval -= (now.tv_nsec - due.tv_nsec) / 1000000L;
+  if (fio_timer_wheel.count[0]) {
+    /* the nearest timer is in the lowest level (one tick per slot) */
+    for (uint64_t tick = fio_timer_wheel.current; tick < due; ++tick) {
+      if (fio_ls_embd_any(
+              &fio_timer_wheel.slots[0][tick & FIO_TIMER_WHEEL_MASK])) {
+        due = tick;
+        break;
+      }
+    }
   }
-  if (interval > FIO_POLL_TICK)
-    interval = FIO_POLL_TICK;
-  return interval;
-}
-
-/* simple a<=>b if "a" is bigger a negative result is returned, eq == 0. */
-static int fio_timer_compare(struct timespec a, struct timespec b) {
-  if (a.tv_sec == b.tv_sec) {
-    if (a.tv_nsec < b.tv_nsec)
-      return 1;
-    if (a.tv_nsec > b.tv_nsec)
-      return -1;
+  fio_mutex_unlock(&fio_timer_lock);
+  if (due <= now)
     return 0;
-  }
-  if (a.tv_sec < b.tv_sec)
-    return 1;
-  return -1;
+  return (size_t)(due - now);
 }
 
-/** Places a timer in an ordered linked list. */
-static void fio_timer_add_order(fio_timer_s *timer) {
-  timer->due = fio_timer_calc_due(timer->interval);
-  // fio_ls_embd_s *pos = &fio_timers;
-  fio_lock(&fio_timer_lock);
-  FIO_LS_EMBD_FOR(&fio_timers, node) {
-    fio_timer_s *t2 = FIO_LS_EMBD_OBJ(fio_timer_s, node, node);
-    if (fio_timer_compare(timer->due, t2->due) >= 0) {
-      fio_ls_embd_push(node, &timer->node);
-      goto finish;
-    }
-  }
-  fio_ls_embd_push(&fio_timers, &timer->node);
-finish:
-  fio_unlock(&fio_timer_lock);
+/** Calls the `on_finish` callback and frees the timer. */
+static void fio_timer_finish(fio_timer_s *timer) {
+  if (timer->on_finish)
+    timer->on_finish(timer->arg);
+  free(timer);
 }
 
-/** Performs a timer task and re-adds it to the queue (or cleans it up) */
+/** Performs a timer task and re-adds it to the wheel (or cleans it up) */
 static void fio_timer_perform_single(void *timer_, void *ignr) {
   fio_timer_s *timer = timer_;
+  /* `fio_timer_cancel` might be called concurrently, decide under the lock */
+  fio_mutex_lock(&fio_timer_lock);
+  uint8_t canceled = (timer->state == FIO_TIMER_CANCELED);
+  fio_mutex_unlock(&fio_timer_lock);
+  if (canceled)
+    goto finish;
+  const uint64_t start = fio_histogram_now();
   timer->task(timer->arg);
-  if (!timer->repetitions || fio_atomic_sub(&timer->repetitions, 1))
-    goto reschedule;
-  if (timer->on_finish)
-    timer->on_finish(timer->arg);
-  free(timer);
-  return;
+  fio_histogram_add(FIO_HISTOGRAM_TIMER, fio_histogram_now() - start);
+  fio_mutex_lock(&fio_timer_lock);
+  if (timer->state != FIO_TIMER_CANCELED &&
+      (!timer->repetitions || --timer->repetitions)) {
+    timer->due = fio_timer_now() + timer->interval;
+    fio_timer_insert_unsafe(timer);
+    fio_mutex_unlock(&fio_timer_lock);
+    return;
+  }
+  /* finished - the handle is invalid from now on (cancel returns -1) */
+  timer->state = FIO_TIMER_CANCELED;
+  fio_mutex_unlock(&fio_timer_lock);
+finish:
+  fio_timer_finish(timer);
   (void)ignr;
-reschedule:
-  fio_timer_add_order(timer);
+}
+
+/** moves the timers in a slot to a lower level (the lock must be held). */
+static void fio_timer_cascade_unsafe(size_t level, size_t slot) {
+  fio_ls_embd_s *list = &fio_timer_wheel.slots[level][slot];
+  while (fio_ls_embd_any(list)) {
+    fio_timer_s *timer =
+        FIO_LS_EMBD_OBJ(fio_timer_s, node, fio_ls_embd_shift(list));
+    --fio_timer_wheel.count[level];
+    fio_timer_add_unsafe(timer);
+  }
 }
 
 /** schedules all timers that are due to be performed. */
 static void fio_timer_schedule(void) {
-  struct timespec now = fio_last_tick();
-  fio_lock(&fio_timer_lock);
-  while (fio_ls_embd_any(&fio_timers) &&
-         fio_timer_compare(
-             FIO_LS_EMBD_OBJ(fio_timer_s, node, fio_timers.next)->due, now) >=
-             0) {
-    fio_ls_embd_s *tmp = fio_ls_embd_remove(fio_timers.next);
-    fio_defer(fio_timer_perform_single, FIO_LS_EMBD_OBJ(fio_timer_s, node, tmp),
-              NULL);
+  const uint64_t now = fio_timer_now();
+  fio_mutex_lock(&fio_timer_lock);
+  while (fio_timer_wheel.current <= now) {
+    if (!fio_timer_count_unsafe()) {
+      fio_timer_wheel.current = now + 1;
+      break;
+    }
+    const uint64_t tick = fio_timer_wheel.current;
+    size_t slot = tick & FIO_TIMER_WHEEL_MASK;
+    /* cascade higher levels every time a lower level completes a cycle */
+    for (size_t level = 1; !slot && level < FIO_TIMER_WHEEL_LEVELS; ++level) {
+      slot = (tick >> (FIO_TIMER_WHEEL_BITS * level)) & FIO_TIMER_WHEEL_MASK;
+      fio_timer_cascade_unsafe(level, slot);
+    }
+    /* all the timers in the lowest level slot are due (batch expiry) */
+    fio_ls_embd_s *list =
+        &fio_timer_wheel.slots[0][tick & FIO_TIMER_WHEEL_MASK];
+    while (fio_ls_embd_any(list)) {
+      fio_timer_s *timer =
+          FIO_LS_EMBD_OBJ(fio_timer_s, node, fio_ls_embd_shift(list));
+      --fio_timer_wheel.count[0];
+      timer->state = FIO_TIMER_SCHEDULED;
+      fio_defer(fio_timer_perform_single, timer, NULL);
+    }
+    if (fio_timer_wheel.count[0]) {
+      ++fio_timer_wheel.current;
+    } else {
+      /* skip to the next cascade of a level holding timers (or to `now`) */
+      size_t level = 1;
+      while (level + 1 < FIO_TIMER_WHEEL_LEVELS && !fio_timer_wheel.count[level])
+        ++level;
+      const size_t shift = FIO_TIMER_WHEEL_BITS * level;
+      fio_timer_wheel.current = ((tick >> shift) + 1) << shift;
+      if (fio_timer_wheel.current > now + 1)
+        fio_timer_wheel.current = now + 1;
+    }
   }
-  fio_unlock(&fio_timer_lock);
+  fio_mutex_unlock(&fio_timer_lock);
 }
 
 static void fio_timer_clear_all(void) {
-  fio_lock(&fio_timer_lock);
-  while (fio_ls_embd_any(&fio_timers)) {
-    fio_timer_s *timer =
-        FIO_LS_EMBD_OBJ(fio_timer_s, node, fio_ls_embd_pop(&fio_timers));
-    if (timer->on_finish)
-      timer->on_finish(timer->arg);
-    free(timer);
+  fio_mutex_lock(&fio_timer_lock);
+  for (size_t i = 0; fio_timer_wheel.initialized && i < FIO_TIMER_WHEEL_LEVELS;
+       ++i) {
+    for (size_t j = 0; j < FIO_TIMER_WHEEL_SLOTS; ++j) {
+      while (fio_ls_embd_any(&fio_timer_wheel.slots[i][j])) {
+        fio_timer_finish(FIO_LS_EMBD_OBJ(
+            fio_timer_s, node, fio_ls_embd_pop(&fio_timer_wheel.slots[i][j])));
+      }
+    }
+    fio_timer_wheel.count[i] = 0;
   }
-  fio_unlock(&fio_timer_lock);
+  fio_mutex_unlock(&fio_timer_lock);
 }
 
 /**
@@ -1295,27 +2487,61 @@ static void fio_timer_clear_all(void) {
  * The task will repeat `repetitions` times. If `repetitions` is set to 0, task
  * will repeat forever.
  *
- * Returns -1 on error.
+ * Returns a timer handle (see `fio_timer_cancel`) or NULL on error.
  *
  * The `on_finish` handler is always called (even on error).
  */
-int fio_run_every(size_t milliseconds, size_t repetitions, void (*task)(void *),
-                  void *arg, void (*on_finish)(void *)) {
+fio_timer_s *fio_run_every(size_t milliseconds, size_t repetitions,
+                           void (*task)(void *), void *arg,
+                           void (*on_finish)(void *)) {
   if (!task || (milliseconds == 0 && !repetitions))
-    return -1;
+    goto error;
   fio_timer_s *timer = malloc(sizeof(*timer));
   FIO_ASSERT_ALLOC(timer);
   fio_mark_time();
   *timer = (fio_timer_s){
-      .due = fio_timer_calc_due(milliseconds),
+      .due = fio_timer_now() + milliseconds,
       .interval = milliseconds,
       .repetitions = repetitions,
       .task = task,
       .arg = arg,
       .on_finish = on_finish,
   };
-  fio_timer_add_order(timer);
-  return 0;
+  fio_mutex_lock(&fio_timer_lock);
+  fio_timer_insert_unsafe(timer);
+  fio_mutex_unlock(&fio_timer_lock);
+  return timer;
+error:
+  return NULL;
+}
+
+/**
+ * Cancels a timer, so it's task will not be performed again.
+ *
+ * The `on_finish` handler will be called (possibly during this call) and the
+ * timer handle will be invalidated.
+ *
+ * Returns -1 on error (i.e., if the timer was already canceled).
+ */
+int fio_timer_cancel(fio_timer_s *timer) {
+  if (!timer)
+    return -1;
+  fio_mutex_lock(&fio_timer_lock);
+  switch ((uint8_t)timer->state) {
+  case FIO_TIMER_WAITING:
+    fio_ls_embd_remove(&timer->node);
+    --fio_timer_wheel.count[timer->level];
+    fio_mutex_unlock(&fio_timer_lock);
+    fio_timer_finish(timer);
+    return 0;
+  case FIO_TIMER_SCHEDULED:
+    /* the timer will be finished by `fio_timer_perform_single` */
+    timer->state = FIO_TIMER_CANCELED;
+    fio_mutex_unlock(&fio_timer_lock);
+    return 0;
+  }
+  fio_mutex_unlock(&fio_timer_lock);
+  return -1;
 }
 
 /* *****************************************************************************
@@ -1500,50 +2726,206 @@ int fio_is_master(void) {
 /** returns facil.io's parent (root) process pid. */
 pid_t fio_parent_pid(void) { return fio_data->parent; }
 
-static inline size_t fio_detect_cpu_cores(void) {
-  ssize_t cpu_count = 0;
-#ifdef _SC_NPROCESSORS_ONLN
-  cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
-  if (cpu_count < 0) {
-    FIO_LOG_WARNING("CPU core count auto-detection failed.");
+/* *****************************************************************************
+Concurrency auto-detection (CPU cores, affinity, cgroup quotas and memory)
+***************************************************************************** */
+
+/* the resource limits imposed on the process, collected once (before forking) */
+static struct {
+  size_t online;   /* online CPU cores (host) */
+  size_t affinity; /* cores allowed by the affinity mask (includes cpusets) */
+  size_t quota;    /* CFS quota, rounded up to whole cores (0 == no quota) */
+  size_t memory;   /* memory limit in bytes (0 == no limit) */
+  size_t cores;    /* the effective number of usable cores */
+  uint8_t collected;
+} fio_limits;
+
+#if defined(__linux__)
+/* reads a small (cgroup / proc) file into `buf`, returning the length read */
+static size_t fio_limits_read(const char *path, char *buf, size_t len) {
+  int fd = open(path, O_RDONLY);
+  if (fd == -1)
     return 0;
-  }
-#else
-  FIO_LOG_WARNING("CPU core count auto-detection failed.");
-#endif
-  return cpu_count;
+  ssize_t r = read(fd, buf, len - 1);
+  close(fd);
+  if (r <= 0)
+    return 0;
+  buf[r] = 0;
+  return (size_t)r;
 }
 
-/**
- * Returns the number of expected threads / processes to be used by facil.io.
- *
- * The pointers should start with valid values that match the expected threads /
- * processes values passed to `fio_run`.
- *
- * The data in the pointers will be overwritten with the result.
- */
-void fio_expected_concurrency(int16_t *threads, int16_t *processes) {
-  if (!threads || !processes)
+/* parses a CFS quota / period pair into whole cores (rounded up) */
+static size_t fio_limits_quota2cores(int64_t quota, int64_t period) {
+  if (quota <= 0 || period <= 0)
+    return 0;
+  return (size_t)((quota + period - 1) / period);
+}
+
+/* keeps the lowest non-zero limit */
+static inline void fio_limits_min(size_t *dest, size_t limit) {
+  if (limit && (!*dest || limit < *dest))
+    *dest = limit;
+}
+
+/* reads a memory limit file (values above 2^60 are "unlimited" in cgroup v1) */
+static size_t fio_limits_read_memory(const char *path) {
+  char buf[64];
+  if (!fio_limits_read(path, buf, sizeof(buf)) || buf[0] < '0' || buf[0] > '9')
+    return 0;
+  char *pos = buf;
+  int64_t limit = fio_atol(&pos);
+  if (limit <= 0 || (uint64_t)limit >= ((uint64_t)1 << 60))
+    return 0;
+  return (size_t)limit;
+}
+
+/* collects cgroup v2 limits, walking from the process's cgroup to the root */
+static void fio_limits_cgroup_v2(void) {
+  char buf[1024];
+  char path[1280];
+  if (!fio_limits_read("/proc/self/cgroup", buf, sizeof(buf)))
+    return;
+  char *group = buf;
+  while (group && (group[0] != '0' || group[1] != ':' || group[2] != ':')) {
+    group = strchr(group, '\n');
+    if (group)
+      ++group;
+  }
+  if (!group)
+    return;
+  group += 3;
+  char *eol = strchr(group, '\n');
+  if (eol)
+    *eol = 0;
+  size_t len = (size_t)snprintf(path, sizeof(path), "/sys/fs/cgroup%s", group);
+  if (len >= sizeof(path) - 16)
+    return;
+  while (len && path[len - 1] == '/')
+    --len;
+  for (;;) {
+    char *pos;
+    memcpy(path + len, "/cpu.max", 9);
+    if (fio_limits_read(path, buf, 64) && buf[0] >= '0' && buf[0] <= '9') {
+      pos = buf;
+      int64_t quota = fio_atol(&pos);
+      int64_t period = fio_atol(&pos);
+      fio_limits_min(&fio_limits.quota, fio_limits_quota2cores(quota, period));
+    }
+    memcpy(path + len, "/memory.max", 12);
+    fio_limits_min(&fio_limits.memory, fio_limits_read_memory(path));
+    /* step up to the parent cgroup */
+    if (len <= 14) /* strlen("/sys/fs/cgroup") */
+      return;
+    while (len > 14 && path[len - 1] != '/')
+      --len;
+    if (len > 14)
+      --len;
+  }
+}
+
+/* collects cgroup v1 limits (the container's view of the mounted hierarchy) */
+static void fio_limits_cgroup_v1(void) {
+  static const char *cpu_dirs[] = {"/sys/fs/cgroup/cpu,cpuacct",
+                                   "/sys/fs/cgroup/cpu", NULL};
+  char buf[64];
+  char path[128];
+  for (size_t i = 0; cpu_dirs[i]; ++i) {
+    int64_t quota, period;
+    char *pos = buf;
+    snprintf(path, sizeof(path), "%s/cpu.cfs_quota_us", cpu_dirs[i]);
+    if (!fio_limits_read(path, buf, sizeof(buf)))
+      continue;
+    quota = fio_atol(&pos);
+    snprintf(path, sizeof(path), "%s/cpu.cfs_period_us", cpu_dirs[i]);
+    if (!fio_limits_read(path, buf, sizeof(buf)))
+      continue;
+    pos = buf;
+    period = fio_atol(&pos);
+    fio_limits_min(&fio_limits.quota, fio_limits_quota2cores(quota, period));
+    break;
+  }
+  fio_limits_min(
+      &fio_limits.memory,
+      fio_limits_read_memory("/sys/fs/cgroup/memory/memory.limit_in_bytes"));
+}
+#endif /* __linux__ */
+
+/* collects the CPU and memory limits imposed on the process */
+static void fio_limits_collect(void) {
+  ssize_t cpu_count = 0;
+#ifdef _SC_NPROCESSORS_ONLN
+  cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  fio_limits.online = (cpu_count > 0 ? (size_t)cpu_count : 0);
+#if FIO_AFFINITY
+  {
+    /* cpusets (cgroup v1 / v2) are enforced through the affinity mask */
+    cpu_set_t set;
+    if (!sched_getaffinity(0, sizeof(set), &set))
+      fio_limits.affinity = CPU_COUNT(&set);
+  }
+#endif
+#if defined(__linux__)
+  fio_limits_cgroup_v2();
+  fio_limits_cgroup_v1();
+#endif
+  fio_limits.cores = fio_limits.online;
+  fio_limits_min(&fio_limits.cores, fio_limits.affinity);
+  fio_limits_min(&fio_limits.cores, fio_limits.quota);
+  fio_limits.collected = 1;
+}
+
+/* returns the number of CPU cores the process can actually use */
+static inline size_t fio_detect_cpu_cores(void) {
+  if (!fio_limits.collected)
+    fio_limits_collect();
+  if (!fio_limits.cores)
+    FIO_LOG_WARNING("CPU core count auto-detection failed.");
+  return fio_limits.cores;
+}
+
+/* logs the detected limits (once, during the first startup) */
+static void fio_limits_log(void) {
+  static uint8_t logged;
+  char quota[32] = "none";
+  char memory[32] = "none";
+  if (logged)
     return;
+  logged = 1;
+  if (!fio_limits.collected)
+    fio_limits_collect();
+  if (fio_limits.quota)
+    snprintf(quota, sizeof(quota), "%zu cores", fio_limits.quota);
+  if (fio_limits.memory)
+    snprintf(memory, sizeof(memory), "%zu MiB",
+             fio_limits.memory >> 20);
+  FIO_LOG_INFO("Detected %zu usable CPU cores (online: %zu, affinity: %zu, "
+               "CPU quota: %s, memory limit: %s)",
+               fio_limits.cores, fio_limits.online, fio_limits.affinity, quota,
+               memory);
+}
+
+/**
+ * Returns the number of expected threads / processes to be used by facil.io.
+ *
+ * The pointers should start with valid values that match the expected threads /
+ * processes values passed to `fio_run`.
+ *
+ * The data in the pointers will be overwritten with the result.
+ */
+void fio_expected_concurrency(int16_t *threads, int16_t *processes) {
+  if (!threads || !processes)
+    return;
+  const uint8_t auto_workers = (*processes <= 0);
   if (!*threads && !*processes) {
     /* both options set to 0 - default to cores*cores matrix */
     ssize_t cpu_count = fio_detect_cpu_cores();
+    *threads = *processes = (int16_t)cpu_count;
 #if FIO_CPU_CORES_LIMIT
-    if (cpu_count > FIO_CPU_CORES_LIMIT) {
-      static int print_cores_warning = 1;
-      if (print_cores_warning) {
-        FIO_LOG_WARNING(
-            "Detected %zu cores. Capping auto-detection of cores to %zu.\n"
-            "      Avoid this message by setting threads / workers manually.\n"
-            "      To increase auto-detection limit, recompile with:\n"
-            "             -DFIO_CPU_CORES_LIMIT=%zu",
-            (size_t)cpu_count, (size_t)FIO_CPU_CORES_LIMIT, (size_t)cpu_count);
-        print_cores_warning = 0;
-      }
-      cpu_count = FIO_CPU_CORES_LIMIT;
-    }
+    /* workers scale with the cores, threads per worker are capped */
+    if (cpu_count > FIO_CPU_CORES_LIMIT)
+      *threads = FIO_CPU_CORES_LIMIT;
 #endif
-    *threads = *processes = (int16_t)cpu_count;
     if (cpu_count > 3) {
       /* leave a core available for the kernel */
       --(*processes);
@@ -1570,29 +2952,580 @@ void fio_expected_concurrency(int16_t *threads, int16_t *processes) {
         *processes = -1 * *threads;
         worker_cpu_adjust = 0;
       }
-      *threads = tmp;
-      tmp = *processes;
-      if (worker_cpu_adjust && (*processes * *threads) >= cpu_count &&
-          cpu_count > 3) {
-        /* leave a resources available for the kernel */
-        --*processes;
+      *threads = tmp;
+      tmp = *processes;
+      if (worker_cpu_adjust && (*processes * *threads) >= cpu_count &&
+          cpu_count > 3) {
+        /* leave a resources available for the kernel */
+        --*processes;
+      }
+      if (thread_cpu_adjust && (*threads * tmp) >= cpu_count && cpu_count > 3) {
+        /* leave a resources available for the kernel */
+        --*threads;
+      }
+    }
+  }
+
+  /* auto-detected workers must fit within the memory limit (if any) */
+  if (auto_workers && FIO_WORKER_MEMORY_MIN && !fio_limits.collected)
+    fio_limits_collect();
+  if (auto_workers && FIO_WORKER_MEMORY_MIN && fio_limits.memory &&
+      (size_t)*processes > fio_limits.memory / FIO_WORKER_MEMORY_MIN)
+    *processes = (int16_t)(fio_limits.memory / FIO_WORKER_MEMORY_MIN);
+
+  /* make sure we have at least one process and at least one thread */
+  if (*processes <= 0)
+    *processes = 1;
+  if (*threads <= 0)
+    *threads = 1;
+}
+
+/* *****************************************************************************
+Runtime Statistics
+***************************************************************************** */
+
+/* counts the tasks waiting in a task queue shard */
+static size_t fio_defer_queue_count(fio_task_queue_s *queue) {
+  size_t count = 0;
+  fio_lock(&queue->lock);
+  for (fio_defer_queue_block_s *block = queue->reader; block;
+       block = block->next) {
+    count += (block->state ? DEFER_QUEUE_BLOCK_COUNT : 0) + block->write -
+             block->read;
+    if (block == queue->writer)
+      break;
+  }
+  fio_unlock(&queue->lock);
+  return count;
+}
+
+/**
+ * Returns the current process's runtime statistics.
+ *
+ * Counters are collected per thread (without locking) and aggregated on
+ * demand, while queue and connection states are reviewed during the call.
+ */
+fio_stats_s fio_stats(void) {
+  fio_stats_s stats = {
+      .queue_blocks = fio_defer_count_alloc - fio_defer_count_dealloc,
+  };
+  /* task queues */
+  for (size_t i = 0; i < FIO_DEFER_QUEUE_SHARDS; ++i) {
+    stats.tasks_pending += fio_defer_queue_count(task_queue_normal + i);
+    stats.tasks_pending += fio_defer_queue_count(task_queue_urgent + i);
+  }
+  stats.tasks_pending += fio_defer_queue_count(&task_queue_postponed);
+  for (size_t i = 0; i < fio_defer_locals_count; ++i) {
+    fio_lock(&fio_defer_locals[i].lock);
+    stats.tasks_pending += fio_defer_locals[i].tail - fio_defer_locals[i].head;
+    fio_unlock(&fio_defer_locals[i].lock);
+  }
+  /* timers */
+  fio_mutex_lock(&fio_timer_lock);
+  stats.timers_pending = fio_timer_count_unsafe();
+  fio_mutex_unlock(&fio_timer_lock);
+  /* connections and their outgoing data */
+  for (size_t i = 0; i <= fio_data->max_protocol_fd; ++i) {
+    if (!fd_data(i).open)
+      continue;
+    ++stats.connections;
+    if (!fd_data(i).packet)
+      continue;
+    fio_lock(&fd_data(i).sock_lock);
+    stats.packets_pending += fd_cold(i).packet_count;
+    for (fio_packet_s *packet = fd_data(i).packet; packet;
+         packet = packet->next)
+      stats.bytes_pending += packet->length;
+    fio_unlock(&fd_data(i).sock_lock);
+  }
+  /* per thread counters */
+  for (size_t i = 0; i < FIO_STATS_SLOTS; ++i) {
+    stats.poll_calls += fio_stats_slots[i].c.poll_calls;
+    stats.poll_events += fio_stats_slots[i].c.poll_events;
+    stats.poll_arms += fio_stats_slots[i].c.poll_arms;
+    stats.read_calls += fio_stats_slots[i].c.read_calls;
+    stats.bytes_read += fio_stats_slots[i].c.bytes_read;
+    stats.bytes_written += fio_stats_slots[i].c.bytes_written;
+    stats.thread_parks += fio_stats_slots[i].c.thread_parks;
+    stats.thread_wakes += fio_stats_slots[i].c.thread_wakes;
+  }
+  return stats;
+}
+
+/**
+ * Collects a latency histogram for the current process, merging the per
+ * thread histograms into `dest`.
+ */
+void fio_histogram(fio_histogram_e type, fio_histogram_s *dest) {
+  if (!dest)
+    return;
+  memset(dest, 0, sizeof(*dest));
+  if ((size_t)type >= FIO_HISTOGRAM_TYPES)
+    return;
+  for (size_t i = 0; i < FIO_STATS_SLOTS; ++i) {
+    fio_histogram_s *h = &fio_histogram_slots[i][type];
+    dest->count += h->count;
+    dest->total += h->total;
+    if (dest->max < h->max)
+      dest->max = h->max;
+    for (size_t j = 0; j < FIO_HISTOGRAM_BUCKETS; ++j)
+      dest->buckets[j] += h->buckets[j];
+  }
+}
+
+/** Returns the (approximate) value at a percentile (0-100) of a histogram. */
+size_t fio_histogram_percentile(fio_histogram_s *h, double percentile) {
+  if (!h || !h->count)
+    return 0;
+  if (percentile >= 100)
+    return h->max;
+  const double rank = (h->count * (percentile < 0 ? 0 : percentile)) / 100.0;
+  size_t target = (size_t)rank;
+  if (target < rank || !target)
+    ++target;
+  size_t seen = 0;
+  for (size_t i = 0; i < FIO_HISTOGRAM_BUCKETS; ++i) {
+    seen += h->buckets[i];
+    if (seen >= target) {
+      const uint64_t value = fio_histogram_bucket_max(i);
+      return (value < h->max ? (size_t)value : h->max);
+    }
+  }
+  return h->max;
+}
+
+/** Clears all the latency histograms for the current process. */
+void fio_histogram_clear(void) {
+  memset(fio_histogram_slots, 0, sizeof(fio_histogram_slots));
+}
+
+/** Logs a summary of all the latency histograms. */
+void fio_histogram_log(void) {
+  static const char *names[FIO_HISTOGRAM_TYPES] = {
+      "queue wait", "on_data", "on_ready", "timers", "pub/sub", "polling",
+  };
+  fio_histogram_s h;
+  for (size_t i = 0; i < FIO_HISTOGRAM_TYPES; ++i) {
+    fio_histogram((fio_histogram_e)i, &h);
+    if (!h.count)
+      continue;
+    FIO_LOG_INFO("(%d) %s: %zu samples, mean %zuus, p50 %zuus, p99 %zuus, "
+                 "p99.9 %zuus, max %zuus",
+                 (int)getpid(), names[i], h.count, (h.total / h.count) / 1000,
+                 fio_histogram_percentile(&h, 50) / 1000,
+                 fio_histogram_percentile(&h, 99) / 1000,
+                 fio_histogram_percentile(&h, 99.9) / 1000, h.max / 1000);
+  }
+}
+
+#if FIO_HISTOGRAM_LOG_INTERVAL
+static void fio_histogram_log_task(void *arg) {
+  fio_histogram_log();
+  (void)arg;
+}
+#endif
+
+static fio_lock_i fio_fork_lock = FIO_LOCK_INIT;
+
+/* *****************************************************************************
+Section Start Marker
+
+
+
+
+
+
+
+
+
+
+
+
+
+                       Polling State Machine - epoll
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+***************************************************************************** */
+#if FIO_ENGINE_EPOLL
+#include <sys/epoll.h>
+
+/**
+ * Returns a C string detailing the IO engine selected during compilation.
+ *
+ * Valid values are "kqueue", "epoll", "io_uring" and "poll".
+ */
+char const *fio_engine(void) { return "epoll"; }
+
+/* epoll tester, in and out */
+static int evio_fd[3] = {-1, -1, -1};
+
+/* per-thread epoll sets (reactor per thread mode) */
+static int (*evio_threads)[3] = NULL;
+static size_t evio_threads_count = 0;
+/* the epoll set owned by the current thread (reactor per thread mode) */
+static __thread int *evio_own = NULL;
+
+/* the epoll set that polls the fd */
+#define fio_evio(fd)                                                           \
+  (evio_threads_count ? evio_threads[(uintptr_t)(fd) % evio_threads_count]     \
+                      : evio_fd)
+
+static void fio_poll_set_close(int *set) {
+  for (int i = 0; i < 3; ++i) {
+    if (set[i] != -1) {
+      close(set[i]);
+      set[i] = -1;
+    }
+  }
+}
+
+static int fio_poll_set_init(int *set) {
+  for (int i = 0; i < 3; ++i) {
+    set[i] = epoll_create1(EPOLL_CLOEXEC);
+    if (set[i] == -1)
+      return -1;
+  }
+  for (int i = 1; i < 3; ++i) {
+    struct epoll_event chevent = {
+        .events = (EPOLLOUT | EPOLLIN),
+        .data.fd = set[i],
+    };
+    if (epoll_ctl(set[0], EPOLL_CTL_ADD, set[i], &chevent) == -1)
+      return -1;
+  }
+  return 0;
+}
+
+static void fio_poll_close(void) {
+  for (size_t i = 0; i < evio_threads_count; ++i) {
+    fio_poll_set_close(evio_threads[i]);
+  }
+  free(evio_threads);
+  evio_threads = NULL;
+  evio_threads_count = 0;
+  fio_poll_set_close(evio_fd);
+}
+
+static void fio_poll_init(void) {
+  fio_poll_close();
+  if (fio_poll_set_init(evio_fd))
+    goto error;
+  return;
+error:
+  FIO_LOG_FATAL("couldn't initialize epoll.");
+  fio_poll_close();
+  exit(errno);
+  return;
+}
+
+static inline int fio_poll_add2(int fd, uint32_t events, int ep_fd) {
+  struct epoll_event chevent;
+  int ret;
+  do {
+    errno = 0;
+    chevent = (struct epoll_event){
+        .events = events,
+        .data.fd = fd,
+    };
+    fio_stats_add(poll_arms, 1);
+    ret = epoll_ctl(ep_fd, EPOLL_CTL_MOD, fd, &chevent);
+    if (ret == -1 && errno == ENOENT) {
+      errno = 0;
+      chevent = (struct epoll_event){
+          .events = events,
+          .data.fd = fd,
+      };
+      fio_stats_add(poll_arms, 1);
+      ret = epoll_ctl(ep_fd, EPOLL_CTL_ADD, fd, &chevent);
+    }
+  } while (errno == EINTR);
+
+  return ret;
+}
+
+#if FIO_POLL_EDGE
+/*
+ * Edge triggered mode: every fd is registered once (in the read set) for both
+ * read and write events. Events don't repeat, so:
+ *
+ * * read events are skipped while the connection is suspended (or an `on_data`
+ *   task is already scheduled), and `on_data` is re-queued by the scheduler
+ *   (not the kernel) for as long as `fio_read` returns data;
+ *
+ * * write events are forwarded only when expected (`fio_poll_add_write`). If
+ *   the socket didn't block since the last write, the write event is
+ *   scheduled immediately.
+ */
+
+static inline void fio_poll_add_read(intptr_t fd) {
+  (void)fd; /* the registration persists, events are re-queued by `on_data` */
+}
+
+static inline void fio_poll_add_write(intptr_t fd) {
+  if (fd_data(fd).exclusive)
+    return;
+  if (!fd_data(fd).protocol) {
+    /* not polled (i.e., hijacked), poll for write events only */
+    fio_poll_add2(fd, (EPOLLOUT | EPOLLRDHUP | EPOLLHUP | EPOLLET),
+                  fio_evio(fd)[1]);
+  }
+  fio_atomic_xchange(&fd_data(fd).want_write, 1);
+  if (fd_data(fd).ready_write && fio_atomic_xchange(&fd_data(fd).want_write, 0))
+    fio_defer_push_urgent(deferred_on_ready, (void *)fd2uuid(fd), NULL);
+}
+
+static inline void fio_poll_add(intptr_t fd) {
+  if (fd_data(fd).exclusive)
+    return;
+  fio_atomic_xchange(&fd_data(fd).want_write, 1);
+  /* re-registering an existing fd (MOD) reports any current readiness */
+  fio_poll_add2(fd, (EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLHUP | EPOLLET),
+                fio_evio(fd)[1]);
+}
+
+FIO_FUNC inline void fio_poll_remove_fd(intptr_t fd) {
+  struct epoll_event chevent = {.events = (EPOLLOUT | EPOLLIN), .data.fd = fd};
+  epoll_ctl(fio_evio(fd)[1], EPOLL_CTL_DEL, fd, &chevent);
+}
+
+/* filters edge triggered events, returns the events that should be handled */
+static inline uint32_t fio_poll_edge_filter(int fd, uint32_t events) {
+  if (events & EPOLLOUT) {
+    fio_atomic_xchange(&fd_data(fd).ready_write, 1);
+    if (!fio_atomic_xchange(&fd_data(fd).want_write, 0))
+      events &= ~EPOLLOUT;
+  }
+  if (events & EPOLLIN) {
+    /* marked before testing, so a finishing `on_data` task can't miss it */
+    fio_atomic_xchange(&fd_data(fd).read_pending, 1);
+    if (fio_trylock(&fd_data(fd).scheduled))
+      events &= ~EPOLLIN; /* suspended, or `on_data` is already scheduled */
+    else
+      fio_atomic_xchange(&fd_data(fd).read_pending, 0);
+  }
+  return events;
+}
+
+#else
+
+static inline void fio_poll_add_read(intptr_t fd) {
+  if (fd_data(fd).exclusive)
+    return;
+  fio_poll_add2(fd, (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLONESHOT),
+                fio_evio(fd)[1]);
+  return;
+}
+
+static inline void fio_poll_add_write(intptr_t fd) {
+  if (fd_data(fd).exclusive)
+    return;
+  fio_poll_add2(fd,
+                ((fio_zerocopy_closing(fd) ? 0 : EPOLLOUT) | EPOLLRDHUP |
+                 EPOLLHUP | EPOLLONESHOT),
+                fio_evio(fd)[2]);
+  return;
+}
+
+static inline void fio_poll_add(intptr_t fd) {
+  if (fd_data(fd).exclusive)
+    return;
+  if (fio_poll_add2(fd, (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLONESHOT),
+                    fio_evio(fd)[1]) == -1)
+    return;
+  fio_poll_add2(fd, (EPOLLOUT | EPOLLRDHUP | EPOLLHUP | EPOLLONESHOT),
+                fio_evio(fd)[2]);
+  return;
+}
+
+FIO_FUNC inline void fio_poll_remove_fd(intptr_t fd) {
+  struct epoll_event chevent = {.events = (EPOLLOUT | EPOLLIN), .data.fd = fd};
+  epoll_ctl(fio_evio(fd)[1], EPOLL_CTL_DEL, fd, &chevent);
+  epoll_ctl(fio_evio(fd)[2], EPOLL_CTL_DEL, fd, &chevent);
+}
+
+#define fio_poll_edge_filter(fd, events) (events)
+
+#endif /* FIO_POLL_EDGE */
+
+/**
+ * Registers a socket that is polled by more than one process (a listening
+ * socket shared by worker processes) for read events.
+ *
+ * `EPOLLEXCLUSIVE` wakes a single process per event, but it can't be combined
+ * with `EPOLLONESHOT` (or modified), so the socket is registered once (edge
+ * triggered) and the `on_data` handler must consume all the data or force a
+ * new event.
+ */
+FIO_FUNC int fio_poll_add_read_exclusive(intptr_t fd) {
+#ifdef EPOLLEXCLUSIVE
+  struct epoll_event chevent = {
+      .events = (EPOLLIN | EPOLLEXCLUSIVE | EPOLLET),
+      .data.fd = fd,
+  };
+  if (epoll_ctl(fio_evio(fd)[1], EPOLL_CTL_ADD, fd, &chevent) == -1)
+    return -1;
+  fd_data(fd).exclusive = 1;
+  return 0;
+#else
+  (void)fd;
+  return -1;
+#endif
+}
+
+/* waits for events on an epoll set and handles (or schedules) them */
+static size_t fio_poll_set(int *set, int timeout_millisec) {
+  struct epoll_event internal[2];
+  struct epoll_event events[FIO_POLL_MAX_EVENTS];
+  intptr_t uuids[FIO_POLL_MAX_EVENTS];
+  int total = 0;
+  /* wait for events and handle them */
+  int internal_count = epoll_wait(set[0], internal, 2, timeout_millisec);
+  if (internal_count == 0)
+    return internal_count;
+  for (int j = 0; j < internal_count; ++j) {
+    int active_count =
+        epoll_wait(internal[j].data.fd, events, FIO_POLL_MAX_EVENTS, 0);
+    if (active_count <= 0)
+      continue;
+    /* collect uuids first, as (inline) events might close connections */
+    for (int i = 0; i < active_count; i++) {
+      uuids[i] = fd2uuid(events[i].data.fd);
+    }
+    for (int i = 0; i < active_count; i++) {
+      if ((events[i].events & (~(EPOLLIN | EPOLLOUT))) == EPOLLERR &&
+          !fio_zerocopy_on_error(uuids[i])) {
+        /* zero-copy completions were reaped, re-arm if no events remain */
+        events[i].events &= ~EPOLLERR;
+        if (!events[i].events) {
+          if (internal[j].data.fd == set[1])
+            fio_poll_add_read(events[i].data.fd);
+          else
+            fio_poll_add_write(events[i].data.fd);
+          continue;
+        }
+      }
+      if (events[i].events & (~(EPOLLIN | EPOLLOUT))) {
+        // errors are hendled as disconnections (on_close)
+        if (fio_is_valid(uuids[i]))
+          fio_force_close_in_poll(uuids[i]);
+        continue;
       }
-      if (thread_cpu_adjust && (*threads * tmp) >= cpu_count && cpu_count > 3) {
-        /* leave a resources available for the kernel */
-        --*threads;
+      events[i].events =
+          fio_poll_edge_filter(events[i].data.fd, events[i].events);
+      if (set == evio_own) {
+        // events of a thread's own connections are handled by the thread
+        if (events[i].events & EPOLLOUT)
+          deferred_on_ready((void *)uuids[i], NULL);
+        if (events[i].events & EPOLLIN)
+          deferred_on_data((void *)uuids[i], NULL);
+      } else {
+        // no error, then it's an active event(s)
+        if (events[i].events & EPOLLOUT) {
+          fio_defer_push_urgent(deferred_on_ready, (void *)uuids[i], NULL);
+        }
+        if (events[i].events & EPOLLIN)
+          fio_defer_push_task(deferred_on_data, (void *)uuids[i], NULL);
       }
+    } // end for loop
+    total += active_count;
+  }
+  return total;
+}
+
+static size_t fio_poll(void) {
+  return fio_poll_set((evio_own ? evio_own : evio_fd),
+                      fio_timer_calc_first_interval());
+}
+
+/* *****************************************************************************
+Reactor per thread mode (epoll sets per thread)
+***************************************************************************** */
+
+/* moves the open connections to the epoll sets that should poll them */
+static void fio_poll_reassign(size_t threads) {
+  const size_t limit = fio_data->fd_limit;
+  for (size_t fd = 0; fd < limit; ++fd) {
+    if (fd_data(fd).open)
+      fio_poll_remove_fd(fd);
+  }
+  evio_threads_count = threads;
+  for (size_t fd = 0; fd < limit; ++fd) {
+    if (!fd_data(fd).open)
+      continue;
+    if (fd_data(fd).exclusive) {
+      fd_data(fd).exclusive = 0;
+      fio_poll_add_read_exclusive(fd);
+    } else if (fd_data(fd).scheduled && !FIO_POLL_EDGE) {
+      /* suspended (or already scheduled), only write events are expected */
+      fio_poll_add_write(fd);
+    } else {
+      fio_poll_add(fd);
     }
   }
+}
 
-  /* make sure we have at least one process and at least one thread */
-  if (*processes <= 0)
-    *processes = 1;
-  if (*threads <= 0)
-    *threads = 1;
+/* creates an epoll set per thread, returns -1 on error */
+static int fio_poll_threads_init(size_t count) {
+  evio_threads = malloc(sizeof(*evio_threads) * count);
+  FIO_ASSERT_ALLOC(evio_threads);
+  for (size_t i = 0; i < count; ++i) {
+    evio_threads[i][0] = evio_threads[i][1] = evio_threads[i][2] = -1;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if (fio_poll_set_init(evio_threads[i])) {
+      FIO_LOG_ERROR("couldn't initialize per-thread epoll sets.");
+      for (size_t j = 0; j <= i; ++j) {
+        fio_poll_set_close(evio_threads[j]);
+      }
+      free(evio_threads);
+      evio_threads = NULL;
+      return -1;
+    }
+  }
+  fio_poll_reassign(count);
+  return 0;
 }
 
-static fio_lock_i fio_fork_lock = FIO_LOCK_INIT;
+/* returns all connections to the shared epoll set (threads must be done) */
+static void fio_poll_threads_destroy(void) {
+  const size_t count = evio_threads_count;
+  if (!evio_threads)
+    return;
+  fio_poll_reassign(0);
+  for (size_t i = 0; i < count; ++i) {
+    fio_poll_set_close(evio_threads[i]);
+  }
+  free(evio_threads);
+  evio_threads = NULL;
+}
+
+/* sets the epoll set polled by the current thread */
+static void fio_poll_thread_own(size_t index) {
+  evio_own = (evio_threads && index < evio_threads_count)
+                 ? evio_threads[index]
+                 : NULL;
+}
+
+/* polls the current thread's own connections, handling the events inline */
+static size_t fio_poll_thread(int timeout_millisec) {
+  if (!evio_own)
+    return fio_poll();
+  return fio_poll_set(evio_own, timeout_millisec);
+}
 
+#endif
 /* *****************************************************************************
 Section Start Marker
 
@@ -1608,7 +3541,7 @@ Section Start Marker
 
 
 
-                       Polling State Machine - epoll
+                       Polling State Machine - io_uring
 
 
 
@@ -1624,136 +3557,313 @@ Section Start Marker
 
 
 ***************************************************************************** */
-#if FIO_ENGINE_EPOLL
-#include <sys/epoll.h>
+#if FIO_ENGINE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
 
 /**
  * Returns a C string detailing the IO engine selected during compilation.
  *
- * Valid values are "kqueue", "epoll" and "poll".
+ * Valid values are "kqueue", "epoll", "io_uring" and "poll".
  */
-char const *fio_engine(void) { return "epoll"; }
+char const *fio_engine(void) { return "io_uring"; }
 
-/* epoll tester, in and out */
-static int evio_fd[3] = {-1, -1, -1};
+/*
+ * The io_uring engine uses one-shot `IORING_OP_POLL_ADD` requests instead of
+ * `epoll_ctl` re-arming. Requests are queued in the submission ring and are
+ * submitted in a single batch by the `io_uring_enter` call that also waits for
+ * completions - so a busy reactor pays one system call per cycle rather than
+ * one per (re)armed event.
+ *
+ * If the polling thread is blocked while another thread (re)arms a file
+ * descriptor, the arming thread submits the request itself, so no event is
+ * delayed until the next cycle.
+ *
+ * The `user_data` field holds the uuid and the event kind, so completions for
+ * closed (or reused) file descriptors can be detected and ignored.
+ */
+
+#define FIO_URING_KIND_INTERNAL 0
+#define FIO_URING_KIND_READ 1
+#define FIO_URING_KIND_WRITE 2
+
+static struct {
+  int fd;
+  /* submission queue */
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+  /* completion queue */
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+  /* mappings (for cleanup) */
+  void *sq_map;
+  size_t sq_map_len;
+  void *cq_map;
+  size_t cq_map_len;
+  size_t sqe_map_len;
+  unsigned sq_entries;
+  /* requests written to the ring but not yet submitted */
+  unsigned pending;
+  /* set while the polling thread is blocked in `io_uring_enter` */
+  uint8_t volatile waiting;
+  fio_lock_i lock;
+  fio_lock_i cq_lock;
+} fio_uring = {.fd = -1};
+
+static inline int fio_uring_enter(unsigned to_submit, unsigned min_complete,
+                                  unsigned flags, void *arg, size_t arg_len) {
+  return (int)syscall(__NR_io_uring_enter, fio_uring.fd, to_submit,
+                      min_complete, flags, arg, arg_len);
+}
 
 static void fio_poll_close(void) {
-  for (int i = 0; i < 3; ++i) {
-    if (evio_fd[i] != -1) {
-      close(evio_fd[i]);
-      evio_fd[i] = -1;
-    }
-  }
+  if (fio_uring.sq_map && fio_uring.sq_map != MAP_FAILED)
+    munmap(fio_uring.sq_map, fio_uring.sq_map_len);
+  if (fio_uring.cq_map && fio_uring.cq_map != MAP_FAILED &&
+      fio_uring.cq_map != fio_uring.sq_map)
+    munmap(fio_uring.cq_map, fio_uring.cq_map_len);
+  if (fio_uring.sqes && (void *)fio_uring.sqes != MAP_FAILED)
+    munmap(fio_uring.sqes, fio_uring.sqe_map_len);
+  if (fio_uring.fd != -1)
+    close(fio_uring.fd);
+  fio_uring = (__typeof__(fio_uring)){.fd = -1};
 }
 
 static void fio_poll_init(void) {
   fio_poll_close();
-  for (int i = 0; i < 3; ++i) {
-    evio_fd[i] = epoll_create1(EPOLL_CLOEXEC);
-    if (evio_fd[i] == -1)
-      goto error;
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  fio_uring.fd = (int)syscall(__NR_io_uring_setup, FIO_POLL_URING_ENTRIES,
+                              &params);
+  if (fio_uring.fd == -1)
+    goto error;
+  if (!(params.features & IORING_FEAT_EXT_ARG)) {
+    FIO_LOG_FATAL("io_uring timeouts (IORING_FEAT_EXT_ARG) unsupported.");
+    goto error;
   }
-  for (int i = 1; i < 3; ++i) {
-    struct epoll_event chevent = {
-        .events = (EPOLLOUT | EPOLLIN),
-        .data.fd = evio_fd[i],
-    };
-    if (epoll_ctl(evio_fd[0], EPOLL_CTL_ADD, evio_fd[i], &chevent) == -1)
+  fcntl(fio_uring.fd, F_SETFD, FD_CLOEXEC);
+  fio_uring.sq_map_len =
+      params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  fio_uring.cq_map_len =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if ((params.features & IORING_FEAT_SINGLE_MMAP) &&
+      fio_uring.cq_map_len > fio_uring.sq_map_len)
+    fio_uring.sq_map_len = fio_uring.cq_map_len;
+  fio_uring.sq_map =
+      mmap(NULL, fio_uring.sq_map_len, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, fio_uring.fd, IORING_OFF_SQ_RING);
+  if (fio_uring.sq_map == MAP_FAILED)
+    goto error;
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    fio_uring.cq_map = fio_uring.sq_map;
+  } else {
+    fio_uring.cq_map =
+        mmap(NULL, fio_uring.cq_map_len, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, fio_uring.fd, IORING_OFF_CQ_RING);
+    if (fio_uring.cq_map == MAP_FAILED)
       goto error;
   }
+  fio_uring.sqe_map_len = params.sq_entries * sizeof(struct io_uring_sqe);
+  fio_uring.sqes =
+      mmap(NULL, fio_uring.sqe_map_len, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, fio_uring.fd, IORING_OFF_SQES);
+  if ((void *)fio_uring.sqes == MAP_FAILED)
+    goto error;
+  fio_uring.sq_head =
+      (unsigned *)((uint8_t *)fio_uring.sq_map + params.sq_off.head);
+  fio_uring.sq_tail =
+      (unsigned *)((uint8_t *)fio_uring.sq_map + params.sq_off.tail);
+  fio_uring.sq_mask =
+      (unsigned *)((uint8_t *)fio_uring.sq_map + params.sq_off.ring_mask);
+  fio_uring.sq_array =
+      (unsigned *)((uint8_t *)fio_uring.sq_map + params.sq_off.array);
+  fio_uring.cq_head =
+      (unsigned *)((uint8_t *)fio_uring.cq_map + params.cq_off.head);
+  fio_uring.cq_tail =
+      (unsigned *)((uint8_t *)fio_uring.cq_map + params.cq_off.tail);
+  fio_uring.cq_mask =
+      (unsigned *)((uint8_t *)fio_uring.cq_map + params.cq_off.ring_mask);
+  fio_uring.cqes = (struct io_uring_cqe *)((uint8_t *)fio_uring.cq_map +
+                                           params.cq_off.cqes);
+  fio_uring.sq_entries = params.sq_entries;
+  fio_uring.lock = FIO_LOCK_INIT;
+  fio_uring.cq_lock = FIO_LOCK_INIT;
   return;
 error:
-  FIO_LOG_FATAL("couldn't initialize epoll.");
+  FIO_LOG_FATAL("couldn't initialize io_uring.");
   fio_poll_close();
   exit(errno);
   return;
 }
 
-static inline int fio_poll_add2(int fd, uint32_t events, int ep_fd) {
-  struct epoll_event chevent;
-  int ret;
-  do {
-    errno = 0;
-    chevent = (struct epoll_event){
-        .events = events,
-        .data.fd = fd,
-    };
-    ret = epoll_ctl(ep_fd, EPOLL_CTL_MOD, fd, &chevent);
-    if (ret == -1 && errno == ENOENT) {
-      errno = 0;
-      chevent = (struct epoll_event){
-          .events = events,
-          .data.fd = fd,
-      };
-      ret = epoll_ctl(ep_fd, EPOLL_CTL_ADD, fd, &chevent);
+/* submits queued requests - call only while holding the ring lock */
+static inline void fio_uring_submit_unsafe(unsigned count) {
+  while (count) {
+    int ret = fio_uring_enter(count, 0, 0, NULL, 0);
+    if (ret == 0)
+      break; /* another thread submitted these requests */
+    if (ret > 0) {
+      count -= ((unsigned)ret > count) ? count : (unsigned)ret;
+    } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      FIO_LOG_ERROR("io_uring submission failed (%d)", errno);
+      return;
     }
-  } while (errno == EINTR);
+  }
+  fio_uring.pending = 0;
+}
 
-  return ret;
+/* writes a request to the submission ring, submitting when required */
+static void fio_uring_push(uint8_t opcode, int fd, uint32_t poll_events,
+                           uint64_t addr, uint64_t user_data) {
+  fio_lock(&fio_uring.lock);
+  if (fio_uring.fd == -1)
+    goto finish;
+  unsigned tail = *fio_uring.sq_tail;
+  while (tail - __atomic_load_n(fio_uring.sq_head, __ATOMIC_ACQUIRE) >=
+         fio_uring.sq_entries) {
+    /* the ring is full (some requests might belong to the polling thread) */
+    fio_uring_submit_unsafe(fio_uring.sq_entries);
+  }
+  unsigned index = tail & *fio_uring.sq_mask;
+  struct io_uring_sqe *sqe = fio_uring.sqes + index;
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = addr;
+  sqe->poll32_events = poll_events;
+  sqe->user_data = user_data;
+  fio_uring.sq_array[index] = index;
+  __atomic_store_n(fio_uring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ++fio_uring.pending;
+  if (fio_uring.waiting)
+    fio_uring_submit_unsafe(fio_uring.pending);
+finish:
+  fio_unlock(&fio_uring.lock);
+}
+
+static inline void fio_uring_arm(intptr_t fd, uint8_t kind,
+                                 uint32_t poll_events) {
+  fio_lock_i *armed = fd_data(fd).uring_armed + (kind - 1);
+  if (fio_atomic_xchange(armed, 1))
+    return; /* already waiting for this event */
+  fio_uring_push(IORING_OP_POLL_ADD, (int)fd, poll_events, 0,
+                 ((uint64_t)fd2uuid(fd) << 2) | kind);
 }
 
 static inline void fio_poll_add_read(intptr_t fd) {
-  fio_poll_add2(fd, (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLONESHOT),
-                evio_fd[1]);
+  fio_uring_arm(fd, FIO_URING_KIND_READ, (POLLIN | POLLRDHUP | POLLHUP));
   return;
 }
 
 static inline void fio_poll_add_write(intptr_t fd) {
-  fio_poll_add2(fd, (EPOLLOUT | EPOLLRDHUP | EPOLLHUP | EPOLLONESHOT),
-                evio_fd[2]);
+  fio_uring_arm(fd, FIO_URING_KIND_WRITE,
+                ((fio_zerocopy_closing(fd) ? 0 : POLLOUT) | POLLRDHUP |
+                 POLLHUP));
   return;
 }
 
 static inline void fio_poll_add(intptr_t fd) {
-  if (fio_poll_add2(fd, (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLONESHOT),
-                    evio_fd[1]) == -1)
-    return;
-  fio_poll_add2(fd, (EPOLLOUT | EPOLLRDHUP | EPOLLHUP | EPOLLONESHOT),
-                evio_fd[2]);
+  fio_poll_add_read(fd);
+  fio_poll_add_write(fd);
   return;
 }
 
+/* must be called before `close`, or the pending request keeps the file open. */
 FIO_FUNC inline void fio_poll_remove_fd(intptr_t fd) {
-  struct epoll_event chevent = {.events = (EPOLLOUT | EPOLLIN), .data.fd = fd};
-  epoll_ctl(evio_fd[1], EPOLL_CTL_DEL, fd, &chevent);
-  epoll_ctl(evio_fd[2], EPOLL_CTL_DEL, fd, &chevent);
+  const uint64_t uuid = (uint64_t)fd2uuid(fd);
+  for (uint8_t kind = FIO_URING_KIND_READ; kind <= FIO_URING_KIND_WRITE;
+       ++kind) {
+    if (fio_atomic_xchange(fd_data(fd).uring_armed + (kind - 1), 0))
+      fio_uring_push(IORING_OP_POLL_REMOVE, -1, 0, (uuid << 2) | kind,
+                     FIO_URING_KIND_INTERNAL);
+  }
 }
 
 static size_t fio_poll(void) {
   int timeout_millisec = fio_timer_calc_first_interval();
-  struct epoll_event internal[2];
-  struct epoll_event events[FIO_POLL_MAX_EVENTS];
-  int total = 0;
-  /* wait for events and handle them */
-  int internal_count = epoll_wait(evio_fd[0], internal, 2, timeout_millisec);
-  if (internal_count == 0)
-    return internal_count;
-  for (int j = 0; j < internal_count; ++j) {
-    int active_count =
-        epoll_wait(internal[j].data.fd, events, FIO_POLL_MAX_EVENTS, 0);
-    if (active_count > 0) {
-      for (int i = 0; i < active_count; i++) {
-        if (events[i].events & (~(EPOLLIN | EPOLLOUT))) {
-          // errors are hendled as disconnections (on_close)
-          fio_force_close_in_poll(fd2uuid(events[i].data.fd));
-        } else {
-          // no error, then it's an active event(s)
-          if (events[i].events & EPOLLOUT) {
-            fio_defer_push_urgent(deferred_on_ready,
-                                  (void *)fd2uuid(events[i].data.fd), NULL);
-          }
-          if (events[i].events & EPOLLIN)
-            fio_defer_push_task(deferred_on_data,
-                                (void *)fd2uuid(events[i].data.fd), NULL);
-        }
-      } // end for loop
-      total += active_count;
+  size_t total = 0;
+  if (fio_trylock(&fio_uring.cq_lock))
+    return 0;
+  if (fio_uring.fd == -1)
+    goto finish;
+  if (__atomic_load_n(fio_uring.cq_head, __ATOMIC_RELAXED) !=
+      __atomic_load_n(fio_uring.cq_tail, __ATOMIC_ACQUIRE))
+    timeout_millisec = 0; /* completions are already waiting */
+  {
+    /* submit everything queued since the last cycle and wait for events */
+    struct __kernel_timespec ts = {
+        .tv_sec = timeout_millisec / 1000,
+        .tv_nsec = ((long)timeout_millisec % 1000) * 1000000L,
+    };
+    struct io_uring_getevents_arg arg = {.ts = (uint64_t)(uintptr_t)&ts};
+    unsigned to_submit;
+    fio_lock(&fio_uring.lock);
+    to_submit = fio_uring.pending;
+    fio_uring.pending = 0;
+    fio_uring.waiting = 1;
+    fio_unlock(&fio_uring.lock);
+    int ret = fio_uring_enter(to_submit, (timeout_millisec ? 1 : 0),
+                              IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                              &arg, sizeof(arg));
+    fio_uring.waiting = 0;
+    if (ret == -1 && errno != ETIME && errno != EINTR && to_submit) {
+      /* nothing was submitted, retry during the next cycle */
+      fio_lock(&fio_uring.lock);
+      fio_uring.pending += to_submit;
+      fio_unlock(&fio_uring.lock);
+    }
+  }
+  /* consume completions */
+  unsigned head = *fio_uring.cq_head;
+  unsigned tail = __atomic_load_n(fio_uring.cq_tail, __ATOMIC_ACQUIRE);
+  for (; head != tail; ++head) {
+    struct io_uring_cqe *cqe = fio_uring.cqes + (head & *fio_uring.cq_mask);
+    const uint8_t kind = (uint8_t)(cqe->user_data & 3);
+    const intptr_t uuid = (intptr_t)(cqe->user_data >> 2);
+    int res = cqe->res;
+    if (kind == FIO_URING_KIND_INTERNAL || res == -ECANCELED)
+      continue;
+    const intptr_t fd = fio_uuid2fd(uuid);
+    if ((uint32_t)fd >= fio_data->fd_limit || fd2uuid(fd) != uuid)
+      continue; /* stale event (the file descriptor was closed) */
+    fio_atomic_xchange(fd_data(fd).uring_armed + (kind - 1), 0);
+    ++total;
+    if (res > 0 && (res & (~(POLLIN | POLLOUT))) == POLLERR &&
+        !fio_zerocopy_on_error(uuid)) {
+      /* zero-copy completions were reaped, re-arm if no events remain */
+      if (!(res & (POLLIN | POLLOUT))) {
+        if (kind == FIO_URING_KIND_READ)
+          fio_poll_add_read(fd);
+        else
+          fio_poll_add_write(fd);
+        continue;
+      }
+      res &= ~POLLERR;
+    }
+    if (res < 0 || (res & (~(POLLIN | POLLOUT)))) {
+      // errors are hendled as disconnections (on_close)
+      fio_force_close_in_poll(uuid);
+    } else {
+      // no error, then it's an active event(s)
+      if (res & POLLOUT) {
+        fio_defer_push_urgent(deferred_on_ready, (void *)uuid, NULL);
+      }
+      if (res & POLLIN)
+        fio_defer_push_task(deferred_on_data, (void *)uuid, NULL);
     }
   }
+  __atomic_store_n(fio_uring.cq_head, head, __ATOMIC_RELEASE);
+finish:
+  fio_unlock(&fio_uring.cq_lock);
   return total;
 }
 
-#endif
+#endif /* FIO_ENGINE_IO_URING */
 /* *****************************************************************************
 Section Start Marker
 
@@ -1791,7 +3901,7 @@ Section Start Marker
 /**
  * Returns a C string detailing the IO engine selected during compilation.
  *
- * Valid values are "kqueue", "epoll" and "poll".
+ * Valid values are "kqueue", "epoll", "io_uring" and "poll".
  */
 char const *fio_engine(void) { return "kqueue"; }
 
@@ -1814,6 +3924,7 @@ static inline void fio_poll_add_read(intptr_t fd) {
          0, 0, ((void *)fd));
   do {
     errno = 0;
+    fio_stats_add(poll_arms, 1);
     kevent(evio_fd, chevent, 1, NULL, 0, NULL);
   } while (errno == EINTR);
   return;
@@ -1825,6 +3936,7 @@ static inline void fio_poll_add_write(intptr_t fd) {
          0, 0, ((void *)fd));
   do {
     errno = 0;
+    fio_stats_add(poll_arms, 1);
     kevent(evio_fd, chevent, 1, NULL, 0, NULL);
   } while (errno == EINTR);
   return;
@@ -1838,6 +3950,7 @@ static inline void fio_poll_add(intptr_t fd) {
          EV_ADD | EV_ENABLE | EV_CLEAR | EV_ONESHOT, 0, 0, ((void *)fd));
   do {
     errno = 0;
+    fio_stats_add(poll_arms, 1);
     kevent(evio_fd, chevent, 2, NULL, 0, NULL);
   } while (errno == EINTR);
   return;
@@ -1928,7 +4041,7 @@ Section Start Marker
 /**
  * Returns a C string detailing the IO engine selected during compilation.
  *
- * Valid values are "kqueue", "epoll" and "poll".
+ * Valid values are "kqueue", "epoll", "io_uring" and "poll".
  */
 char const *fio_engine(void) { return "poll"; }
 
@@ -1982,7 +4095,7 @@ static inline void fio_poll_remove_write(int fd) {
 /** returns non-zero if events were scheduled, 0 if idle */
 static size_t fio_poll(void) {
   /* shrink fd poll range */
-  size_t end = fio_data->capa; // max_protocol_fd might break TLS
+  size_t end = fio_data->fd_limit; // max_protocol_fd might break TLS
   size_t start = 0;
   struct pollfd *list = NULL;
   fio_lock(&fio_data->lock);
@@ -2041,6 +4154,20 @@ finish:
 
 #endif /* FIO_ENGINE_POLL */
 
+#if !FIO_ENGINE_EPOLL
+/* The reactor per thread mode requires epoll */
+static int fio_poll_threads_init(size_t count) {
+  (void)count;
+  return -1;
+}
+static void fio_poll_threads_destroy(void) {}
+static void fio_poll_thread_own(size_t index) { (void)index; }
+static size_t fio_poll_thread(int timeout_millisec) {
+  (void)timeout_millisec;
+  return fio_poll();
+}
+#endif
+
 /* *****************************************************************************
 Section Start Marker
 
@@ -2172,7 +4299,9 @@ static void deferred_on_ready_usr(void *arg, void *arg2) {
       return;
     goto postpone;
   }
+  const uint64_t start = fio_histogram_now();
   pr->on_ready((intptr_t)arg, pr);
+  fio_histogram_add(FIO_HISTOGRAM_ON_READY, fio_histogram_now() - start);
   protocol_unlock(pr, FIO_PR_LOCK_WRITE);
   return;
 postpone:
@@ -2196,6 +4325,31 @@ static void deferred_on_ready(void *arg, void *arg2) {
   fio_defer_push_task(deferred_on_ready_usr, arg, NULL);
 }
 
+/* reports a change in a connection's congestion state to it's protocol */
+static void deferred_on_congestion(void *arg, void *arg2) {
+  errno = 0;
+  fio_protocol_s *pr = protocol_try_lock(fio_uuid2fd(arg), FIO_PR_LOCK_WRITE);
+  if (!pr) {
+    if (errno == EBADF)
+      return;
+    goto postpone;
+  }
+  /* states might change more than once before the task is performed */
+  const uint8_t congested = uuid_cold(arg).congested;
+  if (congested != uuid_cold(arg).congested_notified) {
+    uuid_cold(arg).congested_notified = congested;
+    if (congested && pr->on_congested)
+      pr->on_congested((intptr_t)arg, pr);
+    else if (!congested && pr->on_drained)
+      pr->on_drained((intptr_t)arg, pr);
+  }
+  protocol_unlock(pr, FIO_PR_LOCK_WRITE);
+  return;
+postpone:
+  fio_defer_push_task(deferred_on_congestion, arg, NULL);
+  (void)arg2;
+}
+
 static void deferred_on_data(void *uuid, void *arg2) {
   if (fio_is_closed((intptr_t)uuid)) {
     return;
@@ -2209,17 +4363,68 @@ static void deferred_on_data(void *uuid, void *arg2) {
     }
     goto postpone;
   }
-  fio_unlock(&uuid_data(uuid).scheduled);
-  pr->on_data((intptr_t)uuid, pr);
+  if (uuid_data(uuid).budget) {
+    if (!arg2) {
+      /* an IO event (once per reactor cycle) starts a new budget */
+      uuid_data(uuid).budget_used = 0;
+    } else if (uuid_data(uuid).budget_used >= uuid_data(uuid).budget) {
+      /* a greedy connection, let other connections go first */
+      uuid_data(uuid).budget_used = 0;
+      protocol_unlock(pr, FIO_PR_LOCK_TASK);
+      fio_defer_push_task_fn(
+          (fio_defer_task_s){
+              .func = deferred_on_data, .arg1 = uuid, .arg2 = arg2},
+          &task_queue_postponed);
+      return;
+    }
+  }
+  if (FIO_HISTOGRAMS || uuid_data(uuid).budget) {
+    /* budgets count CPU time, so preemption and blocking aren't charged */
+    const uint32_t budget = uuid_data(uuid).budget;
+    const uint64_t start = fio_histogram_now();
+    const uint64_t cpu = (budget ? fio_thread_cpu_ns() : 0);
+    fio_unlock(&uuid_data(uuid).scheduled);
+    pr->on_data((intptr_t)uuid, pr);
+    if (budget)
+      uuid_data(uuid).budget_used +=
+          (uint32_t)((fio_thread_cpu_ns() - cpu) / 1000);
+    fio_histogram_add(FIO_HISTOGRAM_ON_DATA, fio_histogram_now() - start);
+  } else {
+    fio_unlock(&uuid_data(uuid).scheduled);
+    pr->on_data((intptr_t)uuid, pr);
+  }
   protocol_unlock(pr, FIO_PR_LOCK_TASK);
-  if (!fio_trylock(&uuid_data(uuid).scheduled)) {
-    fio_poll_add_read(fio_uuid2fd((intptr_t)uuid));
+#if FIO_POLL_EDGE
+  /* events don't repeat, re-queue until the socket was drained */
+  while (!fio_trylock(&uuid_data(uuid).scheduled)) {
+    if (uuid_data(uuid).read_more ||
+        fio_atomic_xchange(&uuid_data(uuid).read_pending, 0)) {
+      fio_defer_push_task(deferred_on_data, uuid, (void *)1);
+      break;
+    }
+    fio_unlock(&uuid_data(uuid).scheduled);
+    /* a read event might have been skipped before the lock was released */
+    if (!uuid_data(uuid).read_pending)
+      break;
   }
+#else
+  if (!fio_trylock(&uuid_data(uuid).scheduled))
+    fio_poll_add_read(fio_uuid2fd((intptr_t)uuid));
+#endif
   return;
 
 postpone:
-  if (arg2) {
-    /* the event is being forced, so force rescheduling */
+#if FIO_POLL_EDGE
+  if (!arg2 && !uuid_data(uuid).exclusive) {
+    /* the event won't repeat, retry once the next reactor cycle is done */
+    fio_defer_push_task_fn(
+        (fio_defer_task_s){.func = deferred_on_data, .arg1 = uuid},
+        &task_queue_postponed);
+    return;
+  }
+#endif
+  if (arg2 || uuid_data(uuid).exclusive) {
+    /* the event is being forced (or won't repeat), so force rescheduling */
     fio_defer_push_task(deferred_on_data, (void *)uuid, (void *)1);
   } else {
     /* the protocol was locked, so there might not be any need for the event */
@@ -2346,12 +4551,12 @@ static void fio_tcp_addr_cpy(int fd, int family, struct sockaddr *addrinfo) {
                 family == AF_INET
                     ? (void *)&(((struct sockaddr_in *)addrinfo)->sin_addr)
                     : (void *)&(((struct sockaddr_in6 *)addrinfo)->sin6_addr),
-                (char *)fd_data(fd).addr, sizeof(fd_data(fd).addr));
+                (char *)fd_cold(fd).addr, sizeof(fd_cold(fd).addr));
   if (result) {
-    fd_data(fd).addr_len = strlen((char *)fd_data(fd).addr);
+    fd_cold(fd).addr_len = strlen((char *)fd_cold(fd).addr);
   } else {
-    fd_data(fd).addr_len = 0;
-    fd_data(fd).addr[0] = 0;
+    fd_cold(fd).addr_len = 0;
+    fd_cold(fd).addr[0] = 0;
   }
 }
 
@@ -2380,6 +4585,10 @@ intptr_t fio_accept(intptr_t srv_uuid) {
     return -1;
   }
 #endif
+  if (fio_fd_data_reserve(client)) {
+    close(client);
+    return -1;
+  }
   // avoid the TCP delay algorithm.
   {
     int optval = 1;
@@ -2403,10 +4612,10 @@ intptr_t fio_accept(intptr_t srv_uuid) {
   fio_unlock(&fd_data(client).protocol_lock);
   /* copy peer address */
   if (((struct sockaddr *)addrinfo)->sa_family == AF_UNIX) {
-    fd_data(client).addr_len = uuid_data(srv_uuid).addr_len;
-    if (uuid_data(srv_uuid).addr_len) {
-      memcpy(fd_data(client).addr, uuid_data(srv_uuid).addr,
-             uuid_data(srv_uuid).addr_len + 1);
+    fd_cold(client).addr_len = uuid_cold(srv_uuid).addr_len;
+    if (uuid_cold(srv_uuid).addr_len) {
+      memcpy(fd_cold(client).addr, uuid_cold(srv_uuid).addr,
+             uuid_cold(srv_uuid).addr_len + 1);
     }
   } else {
     fio_tcp_addr_cpy(client, ((struct sockaddr *)addrinfo)->sa_family,
@@ -2437,7 +4646,7 @@ static intptr_t fio_unix_socket(const char *address, uint8_t server) {
   if (fd == -1) {
     return -1;
   }
-  if (fio_set_non_block(fd) == -1) {
+  if (fio_fd_data_reserve(fd) || fio_set_non_block(fd) == -1) {
     close(fd);
     return -1;
   }
@@ -2465,13 +4674,20 @@ static intptr_t fio_unix_socket(const char *address, uint8_t server) {
   fio_lock(&fd_data(fd).protocol_lock);
   fio_clear_fd(fd, 1);
   fio_unlock(&fd_data(fd).protocol_lock);
-  if (addr_len < sizeof(fd_data(fd).addr)) {
-    memcpy(fd_data(fd).addr, address, addr_len + 1); /* copy the NUL byte. */
-    fd_data(fd).addr_len = addr_len;
+  if (addr_len < sizeof(fd_cold(fd).addr)) {
+    memcpy(fd_cold(fd).addr, address, addr_len + 1); /* copy the NUL byte. */
+    fd_cold(fd).addr_len = addr_len;
   }
   return fd2uuid(fd);
 }
 
+/* server socket flags (internal) */
+#define FIO_SOCKET_SERVER 1
+/* the server socket shares the port with other sockets (SO_REUSEPORT) */
+#define FIO_SOCKET_REUSE_PORT 2
+/* the server socket is bound, but `listen` isn't called */
+#define FIO_SOCKET_BIND_ONLY 4
+
 /* Creates a TCP/IP socket - returning it's uuid (or -1) */
 static intptr_t fio_tcp_socket(const char *address, const char *port,
                                uint8_t server) {
@@ -2495,7 +4711,7 @@ static intptr_t fio_tcp_socket(const char *address, const char *port,
     return -1;
   }
   // make sure the socket is non-blocking
-  if (fio_set_non_block(fd) < 0) {
+  if (fio_fd_data_reserve(fd) || fio_set_non_block(fd) < 0) {
     freeaddrinfo(addrinfo);
     close(fd);
     return -1;
@@ -2506,6 +4722,17 @@ static intptr_t fio_tcp_socket(const char *address, const char *port,
       int optval = 1;
       setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
     }
+#ifdef SO_REUSEPORT
+    if ((server & FIO_SOCKET_REUSE_PORT)) {
+      // allow worker processes to bind their own listening socket
+      int optval = 1;
+      if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval))) {
+        freeaddrinfo(addrinfo);
+        close(fd);
+        return -1;
+      }
+    }
+#endif
     // bind the address to the socket
     int bound = 0;
     for (struct addrinfo *i = addrinfo; i != NULL; i = i->ai_next) {
@@ -2526,7 +4753,7 @@ static intptr_t fio_tcp_socket(const char *address, const char *port,
                  sizeof(optval));
     }
 #endif
-    if (listen(fd, SOMAXCONN) < 0) {
+    if (!(server & FIO_SOCKET_BIND_ONLY) && listen(fd, SOMAXCONN) < 0) {
       freeaddrinfo(addrinfo);
       close(fd);
       return -1;
@@ -2552,8 +4779,9 @@ socket_okay:
   return fd2uuid(fd);
 }
 
-/* PUBLIC API: opens a server or client socket */
-intptr_t fio_socket(const char *address, const char *port, uint8_t server) {
+/* opens a server or client socket, `server` may contain FIO_SOCKET flags */
+static intptr_t fio_socket_internal(const char *address, const char *port,
+                                    uint8_t server) {
   intptr_t uuid;
   if (port) {
     char *pos = (char *)port;
@@ -2580,7 +4808,7 @@ intptr_t fio_socket(const char *address, const char *port, uint8_t server) {
   if (!port) {
     do {
       errno = 0;
-      uuid = fio_unix_socket(address, server);
+      uuid = fio_unix_socket(address, (server & FIO_SOCKET_SERVER));
     } while (errno == EINTR);
   } else {
     do {
@@ -2591,6 +4819,11 @@ intptr_t fio_socket(const char *address, const char *port, uint8_t server) {
   return uuid;
 }
 
+/* PUBLIC API: opens a server or client socket */
+intptr_t fio_socket(const char *address, const char *port, uint8_t server) {
+  return fio_socket_internal(address, port, (server ? FIO_SOCKET_SERVER : 0));
+}
+
 /* *****************************************************************************
 Internal socket flushing related functions
 ***************************************************************************** */
@@ -2599,6 +4832,17 @@ Internal socket flushing related functions
 #define BUFFER_FILE_READ_SIZE 49152
 #endif
 
+#ifndef FIO_FLUSH_IOV_MAX
+/** The maximum number of buffers gathered by a single `writev` call. */
+#if defined(IOV_MAX)
+#define FIO_FLUSH_IOV_MAX IOV_MAX
+#elif defined(UIO_MAXIOV)
+#define FIO_FLUSH_IOV_MAX UIO_MAXIOV
+#else
+#define FIO_FLUSH_IOV_MAX 64
+#endif
+#endif
+
 #if !defined(USE_SENDFILE) && !defined(USE_SENDFILE_LINUX) &&                  \
     !defined(USE_SENDFILE_BSD) && !defined(USE_SENDFILE_APPLE)
 #if defined(__linux__) /* linux sendfile works  */
@@ -2612,27 +4856,210 @@ Internal socket flushing related functions
 #endif
 
 #endif
-
-static void fio_sock_perform_close_fd(intptr_t fd) { close(fd); }
-
-static inline void fio_sock_packet_rotate_unsafe(uintptr_t fd) {
-  fio_packet_s *packet = fd_data(fd).packet;
-  fd_data(fd).packet = packet->next;
-  fio_atomic_sub(&fd_data(fd).packet_count, 1);
-  if (!packet->next) {
-    fd_data(fd).packet_last = &fd_data(fd).packet;
-    fd_data(fd).packet_count = 0;
-  } else if (&packet->next == fd_data(fd).packet_last) {
-    fd_data(fd).packet_last = &fd_data(fd).packet;
+
+static void fio_sock_perform_close_fd(intptr_t fd) { close(fd); }
+
+/* removes data from the outgoing queue's byte count (the lock must be held) */
+static inline void fio_sock_pending_sub_unsafe(uintptr_t fd, size_t length) {
+  fd_cold(fd).pending_bytes -=
+      (length < fd_cold(fd).pending_bytes ? length : fd_cold(fd).pending_bytes);
+}
+
+/* accounts for data sent from the outgoing queue (the lock must be held) */
+static inline void fio_sock_sent_unsafe(uintptr_t fd, size_t length) {
+  fd_cold(fd).sent += length;
+  fio_sock_pending_sub_unsafe(fd, length);
+  fio_stats_add(bytes_written, length);
+}
+
+/*
+ * Adds data to the outgoing queue's byte count (the lock must be held).
+ *
+ * Returns true if the queue became congested (crossed the high watermark).
+ */
+static inline uint8_t fio_sock_pending_add_unsafe(uintptr_t fd,
+                                                  size_t length) {
+  fd_cold(fd).pending_bytes += length;
+  if (fd_cold(fd).congested || !fd_cold(fd).watermark_high ||
+      fd_cold(fd).pending_bytes <= fd_cold(fd).watermark_high)
+    return 0;
+  fd_cold(fd).congested = 1;
+  return 1;
+}
+
+/*
+ * Tests if a congested outgoing queue drained (the lock must be held).
+ *
+ * Returns true if the queue dropped to (or below) the low watermark.
+ */
+static inline uint8_t fio_sock_drained_unsafe(uintptr_t fd) {
+  if (!fd_cold(fd).congested ||
+      fd_cold(fd).pending_bytes > fd_cold(fd).watermark_low)
+    return 0;
+  fd_cold(fd).congested = 0;
+  return 1;
+}
+
+static inline void fio_sock_packet_rotate_unsafe(uintptr_t fd) {
+  fio_packet_s *packet = fd_data(fd).packet;
+  /* data that will never be sent (i.e., a truncated file) */
+  fio_sock_pending_sub_unsafe(fd, packet->length);
+  fd_data(fd).packet = packet->next;
+  fio_atomic_sub(&fd_cold(fd).packet_count, 1);
+  if (!packet->next) {
+    fd_cold(fd).packet_last = &fd_data(fd).packet;
+    fd_cold(fd).packet_count = 0;
+  } else if (&packet->next == fd_cold(fd).packet_last) {
+    fd_cold(fd).packet_last = &fd_data(fd).packet;
+  }
+#if FIO_ZEROCOPY
+  if (packet->zerocopy_id) {
+    /* the kernel might still be reading the data, wait for the completion */
+    packet->next = NULL;
+    if (!fd_cold(fd).zerocopy_pending)
+      fd_cold(fd).zerocopy_pending_last = &fd_cold(fd).zerocopy_pending;
+    *fd_cold(fd).zerocopy_pending_last = packet;
+    fd_cold(fd).zerocopy_pending_last = &packet->next;
+    return;
+  }
+#endif
+  fio_packet_free(packet);
+}
+
+#if FIO_ZEROCOPY
+/* tests if a buffer packet should be sent using MSG_ZEROCOPY */
+#define fio_sock_zerocopy_eligible(fd, packet)                                 \
+  (fd_cold(fd).zerocopy && (packet)->length >= fd_cold(fd).zerocopy &&         \
+   fd_data(fd).rw_hooks == &FIO_DEFAULT_RW_HOOKS)
+
+/*
+ * Reads the zero-copy completion notifications from the socket's error queue,
+ * freeing the packets the kernel is done with.
+ *
+ * Completions are assumed to arrive in order (as they do for TCP/IP).
+ *
+ * Returns -1 if the error queue contained any other errors.
+ */
+static int fio_sock_zerocopy_reap_unsafe(int fd) {
+  int ret = 0;
+  union {
+    char buf[CMSG_SPACE(sizeof(struct sock_extended_err) +
+                        sizeof(struct sockaddr_in6))];
+    struct cmsghdr align;
+  } control;
+  for (;;) {
+    struct msghdr msg = {
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+    if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+      if (errno == EINTR)
+        continue;
+      break; /* EAGAIN - the error queue is empty */
+    }
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm;
+         cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!(cm->cmsg_level == IPPROTO_IP && cm->cmsg_type == IP_RECVERR) &&
+          !(cm->cmsg_level == IPPROTO_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+        continue;
+      struct sock_extended_err *err = (void *)CMSG_DATA(cm);
+      if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY || err->ee_errno) {
+        ret = -1;
+        continue;
+      }
+      /* `ee_info` to `ee_data` (inclusive) is the range of completed calls */
+      fd_cold(fd).zerocopy_done = err->ee_data + 1;
+      if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+        /* the kernel copied the data anyway (i.e., loopback), stop trying */
+        fd_cold(fd).zerocopy = 0;
+      }
+    }
+  }
+  fio_packet_s *packet;
+  while ((packet = fd_cold(fd).zerocopy_pending) &&
+         (int32_t)(packet->zerocopy_id - fd_cold(fd).zerocopy_done) <= 0) {
+    fd_cold(fd).zerocopy_pending = packet->next;
+    fio_packet_free(packet);
+  }
+  return ret;
+}
+
+/* sends a buffer packet using MSG_ZEROCOPY (the packet is held by rotation) */
+static int fio_sock_write_zerocopy(int fd, fio_packet_s *packet) {
+  if (fd_cold(fd).zerocopy_pending)
+    fio_sock_zerocopy_reap_unsafe(fd);
+  ssize_t written =
+      send(fd, ((uint8_t *)packet->data.buffer + packet->offset),
+           packet->length, MSG_ZEROCOPY | MSG_NOSIGNAL);
+  if (written < 0)
+    return (int)written;
+  fio_sock_sent_unsafe(fd, (size_t)written);
+  /* the kernel numbers the (successful) zero-copy send calls */
+  packet->zerocopy_id = ++fd_cold(fd).zerocopy_sent;
+  packet->length -= written;
+  packet->offset += written;
+  if (!packet->length) {
+    fio_sock_packet_rotate_unsafe(fd);
+  }
+  return (written > INT_MAX ? INT_MAX : (int)written);
+}
+#endif
+
+static int fio_sock_write_buffer(int fd, fio_packet_s *packet);
+
+/* gathers consecutive buffer packets into a single `writev` hook call */
+static int fio_sock_writev_buffers(int fd, fio_packet_s *packet) {
+  struct iovec iov[FIO_FLUSH_IOV_MAX];
+  int count = 0;
+  do {
+    iov[count].iov_base = (uint8_t *)packet->data.buffer + packet->offset;
+    iov[count].iov_len = packet->length;
+    ++count;
+    packet = packet->next;
+  } while (packet && count < FIO_FLUSH_IOV_MAX &&
+           packet->write_func == fio_sock_write_buffer
+#if FIO_ZEROCOPY
+           && !fio_sock_zerocopy_eligible(fd, packet)
+#endif
+  );
+  ssize_t written = fd_data(fd).rw_hooks->writev(
+      fd2uuid(fd), fd_data(fd).rw_udata, iov, count);
+  if (written <= 0)
+    return (int)written;
+  fio_sock_sent_unsafe(fd, (size_t)written);
+  size_t remaining = (size_t)written;
+  while ((packet = fd_data(fd).packet) &&
+         packet->write_func == fio_sock_write_buffer) {
+    if (remaining < packet->length) {
+      packet->length -= remaining;
+      packet->offset += remaining;
+      break;
+    }
+    remaining -= packet->length;
+    fio_sock_packet_rotate_unsafe(fd);
+    if (!remaining)
+      break;
   }
-  fio_packet_free(packet);
+  return (written > INT_MAX ? INT_MAX : (int)written);
 }
 
 static int fio_sock_write_buffer(int fd, fio_packet_s *packet) {
+#if FIO_ZEROCOPY
+  if (fio_sock_zerocopy_eligible(fd, packet)) {
+    int ret = fio_sock_write_zerocopy(fd, packet);
+    if (ret >= 0 || errno != ENOBUFS)
+      return ret;
+    /* out of socket option memory (optmem_max), copy the data instead */
+  }
+#endif
+  if (packet->next && packet->next->write_func == fio_sock_write_buffer &&
+      fd_data(fd).rw_hooks->writev)
+    return fio_sock_writev_buffers(fd, packet);
   int written = fd_data(fd).rw_hooks->write(
       fd2uuid(fd), fd_data(fd).rw_udata,
       ((uint8_t *)packet->data.buffer + packet->offset), packet->length);
   if (written > 0) {
+    fio_sock_sent_unsafe(fd, (size_t)written);
     packet->length -= written;
     packet->offset += written;
     if (!packet->length) {
@@ -2660,6 +5087,8 @@ static int fio_sock_write_from_fd(int fd, fio_packet_s *packet) {
       goto read_error;
     sent = fd_data(fd).rw_hooks->write(fd2uuid(fd), fd_data(fd).rw_udata, buff,
                                        asked);
+    if (sent > 0)
+      fio_sock_sent_unsafe(fd, (size_t)sent);
   } while (sent == asked && packet->length);
   if (sent >= 0) {
     packet->offset += sent;
@@ -2691,6 +5120,7 @@ static int fio_sock_sendfile_from_fd(int fd, fio_packet_s *packet) {
       sendfile64(fd, packet->data.fd, (off_t *)&packet->offset, packet->length);
   if (sent < 0)
     return -1;
+  fio_sock_sent_unsafe(fd, (size_t)sent);
   packet->length -= sent;
   if (!packet->length)
     fio_sock_packet_rotate_unsafe(fd);
@@ -2713,6 +5143,7 @@ static int fio_sock_sendfile_from_fd(int fd, fio_packet_s *packet) {
 #endif
     if (ret < 0)
       goto error;
+    fio_sock_sent_unsafe(fd, (size_t)act_sent);
     packet->length -= act_sent;
     packet->offset += act_sent;
   }
@@ -2720,6 +5151,7 @@ static int fio_sock_sendfile_from_fd(int fd, fio_packet_s *packet) {
   return act_sent;
 error:
   if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+    fio_sock_sent_unsafe(fd, (size_t)act_sent);
     packet->length -= act_sent;
     packet->offset += act_sent;
   }
@@ -2736,6 +5168,9 @@ static int (*fio_sock_sendfile_from_fd)(int fd, fio_packet_s *packet) =
 Socket / Connection Functions
 ***************************************************************************** */
 
+static ssize_t fio_hooks_default_read(intptr_t uuid, void *udata, void *buf,
+                                      size_t count);
+
 /**
  * Returns the information available about the socket's peer address.
  *
@@ -2778,15 +5213,22 @@ ssize_t fio_read(intptr_t uuid, void *buffer, size_t count) {
   int old_errno = errno;
   ssize_t ret;
 retry_int:
+  fio_stats_add(read_calls, 1);
   ret = rw_read(uuid, udata, buffer, count);
   if (ret > 0) {
+    fio_stats_add(bytes_read, ret);
     fio_touch(uuid);
+    /* a short (system) read means the socket was drained */
+    fio_edge_read_more(fio_uuid2fd(uuid),
+                       ((size_t)ret == count ||
+                        rw_read != fio_hooks_default_read));
     return ret;
   }
   if (ret < 0 && errno == EINTR)
     goto retry_int;
   if (ret < 0 &&
       (errno == EWOULDBLOCK || errno == EAGAIN || errno == ENOTCONN)) {
+    fio_edge_read_more(fio_uuid2fd(uuid), 0);
     errno = old_errno;
     return 0;
   }
@@ -2798,11 +5240,64 @@ retry_int:
  * `fio_write2_fn` is the actual function behind the macro `fio_write2`.
  */
 ssize_t fio_write2_fn(intptr_t uuid, fio_write_args_s options) {
+  fio_packet_s *packet;
+  uint8_t was_empty = 1;
+  options.copy &= !options.is_fd;
   if (!uuid_is_valid(uuid))
     goto error;
 
+  if (options.copy) {
+    size_t capa = options.length;
+    void (*dealloc)(void *) = fio_packet_exact_dealloc;
+    const uint8_t *data = (const uint8_t *)options.data.buffer + options.offset;
+    if (options.length < FIO_WRITE_COALESCE_SIZE && !options.urgent &&
+        uuid_data(uuid).packet) {
+      /* append small copies to the last queued packet, if possible */
+      fio_lock(&uuid_data(uuid).sock_lock);
+      if (!uuid_is_valid(uuid)) {
+        fio_unlock(&uuid_data(uuid).sock_lock);
+        goto error;
+      }
+      if (uuid_data(uuid).packet) {
+        packet =
+            FIO_LS_EMBD_OBJ(fio_packet_s, next, uuid_cold(uuid).packet_last);
+        if (packet->dealloc == fio_packet_inline_dealloc &&
+            packet->offset + packet->length + options.length <=
+                FIO_WRITE_COALESCE_SIZE) {
+          memcpy((uint8_t *)packet->data.buffer + packet->offset +
+                     packet->length,
+                 data, options.length);
+          packet->length += options.length;
+          const uint8_t congested = fio_sock_pending_add_unsafe(
+              fio_uuid2fd(uuid), options.length);
+          fio_unlock(&uuid_data(uuid).sock_lock);
+          if (congested)
+            fio_defer_push_task(deferred_on_congestion, (void *)uuid, NULL);
+          return 0;
+        }
+        /*
+         * The last packet is full (or wasn't copied), so small writes are
+         * being queued one after the other - reserve room for the next ones.
+         */
+        capa = FIO_WRITE_COALESCE_SIZE;
+        dealloc = fio_packet_inline_dealloc;
+      }
+      fio_unlock(&uuid_data(uuid).sock_lock);
+    }
+    /* copy the data into a new packet (a single allocation) */
+    packet = fio_packet_alloc_inline(capa);
+    *packet = (fio_packet_s){
+        .length = options.length,
+        .data.buffer = (void *)(packet + 1),
+        .write_func = fio_sock_write_buffer,
+        .dealloc = dealloc,
+    };
+    memcpy(packet + 1, data, options.length);
+    goto add_packet;
+  }
+
   /* create packet */
-  fio_packet_s *packet = fio_packet_alloc();
+  packet = fio_packet_alloc();
   *packet = (fio_packet_s){
       .length = options.length,
       .offset = options.offset,
@@ -2819,8 +5314,8 @@ ssize_t fio_write2_fn(intptr_t uuid, fio_write_args_s options) {
     packet->write_func = fio_sock_write_buffer;
     packet->dealloc = (options.after.dealloc ? options.after.dealloc : free);
   }
+add_packet:
   /* add packet to outgoing list */
-  uint8_t was_empty = 1;
   fio_lock(&uuid_data(uuid).sock_lock);
   if (!uuid_is_valid(uuid)) {
     goto locked_error;
@@ -2828,8 +5323,8 @@ ssize_t fio_write2_fn(intptr_t uuid, fio_write_args_s options) {
   if (uuid_data(uuid).packet)
     was_empty = 0;
   if (options.urgent == 0) {
-    *uuid_data(uuid).packet_last = packet;
-    uuid_data(uuid).packet_last = &packet->next;
+    *uuid_cold(uuid).packet_last = packet;
+    uuid_cold(uuid).packet_last = &packet->next;
   } else {
     fio_packet_s **pos = &uuid_data(uuid).packet;
     if (*pos)
@@ -2837,12 +5332,16 @@ ssize_t fio_write2_fn(intptr_t uuid, fio_write_args_s options) {
     packet->next = *pos;
     *pos = packet;
     if (!packet->next) {
-      uuid_data(uuid).packet_last = &packet->next;
+      uuid_cold(uuid).packet_last = &packet->next;
     }
   }
-  fio_atomic_add(&uuid_data(uuid).packet_count, 1);
+  fio_atomic_add(&uuid_cold(uuid).packet_count, 1);
+  const uint8_t congested =
+      fio_sock_pending_add_unsafe(fio_uuid2fd(uuid), packet->length);
   fio_unlock(&uuid_data(uuid).sock_lock);
 
+  if (congested)
+    fio_defer_push_task(deferred_on_congestion, (void *)uuid, NULL);
   if (was_empty) {
     touchfd(fio_uuid2fd(uuid));
     deferred_on_ready((void *)uuid, (void *)1);
@@ -2854,7 +5353,7 @@ locked_error:
   errno = EBADF;
   return -1;
 error:
-  if (options.after.dealloc) {
+  if (options.after.dealloc && !options.copy) {
     options.after.dealloc((void *)options.data.buffer);
   }
   errno = EBADF;
@@ -2871,7 +5370,7 @@ void FIO_DEALLOC_NOOP(void *arg) { (void)arg; }
 size_t fio_pending(intptr_t uuid) {
   if (!uuid_is_valid(uuid))
     return 0;
-  return uuid_data(uuid).packet_count;
+  return uuid_cold(uuid).packet_count;
 }
 
 /**
@@ -2885,7 +5384,11 @@ void fio_close(intptr_t uuid) {
     errno = EBADF;
     return;
   }
-  if (uuid_data(uuid).packet || uuid_data(uuid).sock_lock) {
+  if (uuid_data(uuid).packet || uuid_data(uuid).sock_lock
+#if FIO_ZEROCOPY
+      || uuid_cold(uuid).zerocopy_pending
+#endif
+  ) {
     uuid_data(uuid).close = 1;
     fio_poll_add_write(fio_uuid2fd(uuid));
     return;
@@ -2912,8 +5415,9 @@ void fio_force_close(intptr_t uuid) {
   fio_lock(&uuid_data(uuid).sock_lock);
   packet = uuid_data(uuid).packet;
   uuid_data(uuid).packet = NULL;
-  uuid_data(uuid).packet_last = &uuid_data(uuid).packet;
-  uuid_data(uuid).sent = 0;
+  uuid_cold(uuid).packet_last = &uuid_data(uuid).packet;
+  uuid_cold(uuid).sent = 0;
+  uuid_cold(uuid).pending_bytes = 0;
   fio_unlock(&uuid_data(uuid).sock_lock);
   while (packet) {
     fio_packet_s *tmp = packet;
@@ -2928,6 +5432,10 @@ void fio_force_close(intptr_t uuid) {
     fio_poll_add_write(fio_uuid2fd(uuid));
     return;
   }
+#if FIO_ENGINE_IO_URING
+  /* pending io_uring requests hold a reference to the file */
+  fio_poll_remove_fd(fio_uuid2fd(uuid));
+#endif
   fio_lock(&uuid_data(uuid).protocol_lock);
   fio_clear_fd(fio_uuid2fd(uuid), 0);
   fio_unlock(&uuid_data(uuid).protocol_lock);
@@ -2958,28 +5466,38 @@ ssize_t fio_flush(intptr_t uuid) {
   if (fio_trylock(&uuid_data(uuid).sock_lock))
     goto would_block;
 
-  if (!uuid_data(uuid).packet)
+  if (!uuid_data(uuid).packet) {
+#if FIO_ZEROCOPY
+    if (uuid_cold(uuid).zerocopy_sent && uuid_data(uuid).close)
+      goto zerocopy_closing;
+#endif
     goto flush_rw_hook;
+  }
 
   const fio_packet_s *old_packet = uuid_data(uuid).packet;
-  const size_t old_sent = uuid_data(uuid).sent;
+  const size_t old_sent = uuid_cold(uuid).sent;
 
+  fio_edge_write_begin(fio_uuid2fd(uuid));
   tmp = uuid_data(uuid).packet->write_func(fio_uuid2fd(uuid),
                                            uuid_data(uuid).packet);
   if (tmp <= 0) {
     goto test_errno;
   }
+  fio_edge_write_done(fio_uuid2fd(uuid));
 
-  if (uuid_data(uuid).packet_count >= FIO_SLOWLORIS_LIMIT &&
+  if (uuid_cold(uuid).packet_count >= FIO_SLOWLORIS_LIMIT &&
       uuid_data(uuid).packet == old_packet &&
-      uuid_data(uuid).sent >= old_sent &&
-      (uuid_data(uuid).sent - old_sent) < 32768) {
+      uuid_cold(uuid).sent >= old_sent &&
+      (uuid_cold(uuid).sent - old_sent) < 32768) {
     /* Slowloris attack assumed */
     goto attacked;
   }
 
+  tmp = fio_sock_drained_unsafe(fio_uuid2fd(uuid));
   /* end critical section */
   fio_unlock(&uuid_data(uuid).sock_lock);
+  if (tmp)
+    fio_defer_push_task(deferred_on_congestion, (void *)uuid, NULL);
 
   /* test for fio_close marker */
   if (!uuid_data(uuid).packet && uuid_data(uuid).close)
@@ -2993,9 +5511,25 @@ would_block:
   return -1;
 
 closed:
+#if FIO_ZEROCOPY
+  if (uuid_cold(uuid).zerocopy_pending)
+    return 1; /* wait for zero-copy completions before closing */
+#endif
   fio_force_close(uuid);
   return -1;
 
+#if FIO_ZEROCOPY
+zerocopy_closing:
+  /* the kernel might still be reading the data, don't close (free) it yet */
+  fio_sock_zerocopy_reap_unsafe(fio_uuid2fd(uuid));
+  flushed = (uuid_cold(uuid).zerocopy_pending != NULL);
+  fio_unlock(&uuid_data(uuid).sock_lock);
+  if (!flushed)
+    goto closed;
+  touchfd(fio_uuid2fd(uuid));
+  return 1;
+#endif
+
 flush_rw_hook:
   flushed = uuid_data(uuid).rw_hooks->flush(uuid, uuid_data(uuid).rw_udata);
   fio_unlock(&uuid_data(uuid).sock_lock);
@@ -3062,6 +5596,66 @@ size_t fio_flush_all(void) {
   return count;
 }
 
+/* *****************************************************************************
+Zero-copy transmission (MSG_ZEROCOPY)
+***************************************************************************** */
+
+/**
+ * Enables zero-copy transmission (`MSG_ZEROCOPY`) for buffers of `threshold`
+ * bytes or more (0 disables zero-copy transmission for the connection).
+ *
+ * Returns -1 on error (or if unsupported). Returns 0 on success.
+ */
+int fio_zerocopy_set(intptr_t uuid, size_t threshold) {
+  if (!uuid_is_valid(uuid))
+    goto invalid;
+#if FIO_ZEROCOPY
+  if (threshold && !uuid_cold(uuid).zerocopy) {
+    int enabled = 1;
+    if (setsockopt(fio_uuid2fd(uuid), SOL_SOCKET, SO_ZEROCOPY, &enabled,
+                   sizeof(enabled)) == -1)
+      return -1;
+  }
+  uuid_cold(uuid).zerocopy = threshold;
+  return 0;
+#else
+  errno = ENOTSUP;
+  return -1;
+  (void)threshold;
+#endif
+invalid:
+  errno = EBADF;
+  return -1;
+}
+
+/* returns 0 if a socket error was (only) a zero-copy completion notification */
+FIO_FUNC int fio_zerocopy_on_error(intptr_t uuid) {
+#if FIO_ZEROCOPY
+  const int fd = fio_uuid2fd(uuid);
+  int ret;
+  if (!uuid_is_valid(uuid) || !fd_cold(fd).zerocopy_sent)
+    return -1;
+  fio_lock(&fd_data(fd).sock_lock);
+  ret = fio_sock_zerocopy_reap_unsafe(fd);
+  fio_unlock(&fd_data(fd).sock_lock);
+  if (fd_data(fd).close) {
+    /* closure might have been waiting for the completions */
+    fio_defer_push_urgent(deferred_on_ready, (void *)uuid, NULL);
+  }
+  if (!ret) {
+    /* test for a pending socket error (errors don't use the error queue) */
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1 || err)
+      ret = -1;
+  }
+  return ret;
+#else
+  return -1;
+  (void)uuid;
+#endif
+}
+
 /* *****************************************************************************
 Connection Read / Write Hooks, for overriding the system calls
 ***************************************************************************** */
@@ -3077,6 +5671,12 @@ static ssize_t fio_hooks_default_write(intptr_t uuid, void *udata,
   (void)(udata);
 }
 
+static ssize_t fio_hooks_default_writev(intptr_t uuid, void *udata,
+                                        const struct iovec *iov, int iovcnt) {
+  return writev(fio_uuid2fd(uuid), iov, iovcnt);
+  (void)(udata);
+}
+
 static ssize_t fio_hooks_default_before_close(intptr_t uuid, void *udata) {
   return 0;
   (void)udata;
@@ -3097,6 +5697,7 @@ const fio_rw_hook_s FIO_DEFAULT_RW_HOOKS = {
     .flush = fio_hooks_default_flush,
     .before_close = fio_hooks_default_before_close,
     .cleanup = fio_hooks_default_cleanup,
+    .writev = fio_hooks_default_writev,
 };
 
 /**
@@ -3116,6 +5717,8 @@ int fio_rw_hook_replace_unsafe(intptr_t uuid, fio_rw_hook_s *rw_hooks,
     rw_hooks->read = fio_hooks_default_read;
   if (!rw_hooks->write)
     rw_hooks->write = fio_hooks_default_write;
+  if (!rw_hooks->writev && rw_hooks->write == fio_hooks_default_write)
+    rw_hooks->writev = fio_hooks_default_writev;
   if (!rw_hooks->flush)
     rw_hooks->flush = fio_hooks_default_flush;
   if (!rw_hooks->before_close)
@@ -3142,6 +5745,8 @@ int fio_rw_hook_set(intptr_t uuid, fio_rw_hook_s *rw_hooks, void *udata) {
     rw_hooks->read = fio_hooks_default_read;
   if (!rw_hooks->write)
     rw_hooks->write = fio_hooks_default_write;
+  if (!rw_hooks->writev && rw_hooks->write == fio_hooks_default_write)
+    rw_hooks->writev = fio_hooks_default_writev;
   if (!rw_hooks->flush)
     rw_hooks->flush = fio_hooks_default_flush;
   if (!rw_hooks->before_close)
@@ -3170,6 +5775,425 @@ invalid_uuid:
   return -1;
 }
 
+/* *****************************************************************************
+Read Buffer Pool
+***************************************************************************** */
+
+/* buffers are prefixed with a small header (keeps the data 16 byte aligned) */
+typedef struct fio_buffer_s {
+  struct fio_buffer_s *next;
+  size_t capa;
+} fio_buffer_s;
+
+/* size classes are powers of 2, starting at 4Kb (4Kb, 8Kb, ... 64Kb) */
+#define FIO_BUFFER_POOL_MIN_BITS 12
+#define FIO_BUFFER_POOL_CLASSES 5
+
+typedef struct {
+  fio_buffer_s *free;
+  size_t count;
+} fio_buffer_list_s;
+
+static struct {
+  fio_buffer_list_s list;
+  fio_lock_i lock;
+} fio_buffer_pool[FIO_BUFFER_POOL_CLASSES];
+
+/* the per-thread cache avoids the shared lock for most borrow / return pairs */
+static __thread fio_buffer_list_s fio_buffer_cache[FIO_BUFFER_POOL_CLASSES];
+
+/* returns the size class for `size` (FIO_BUFFER_POOL_CLASSES if too big) */
+static inline size_t fio_buffer_class(size_t size) {
+  size_t i = 0;
+  while (i < FIO_BUFFER_POOL_CLASSES &&
+         ((size_t)1 << (FIO_BUFFER_POOL_MIN_BITS + i)) < size)
+    ++i;
+  return i;
+}
+
+static inline fio_buffer_s *fio_buffer_list_pop(fio_buffer_list_s *l) {
+  fio_buffer_s *b = l->free;
+  if (b) {
+    l->free = b->next;
+    --l->count;
+  }
+  return b;
+}
+
+static inline void fio_buffer_list_push(fio_buffer_list_s *l, fio_buffer_s *b) {
+  b->next = l->free;
+  l->free = b;
+  ++l->count;
+}
+
+/**
+ * Borrows a buffer with a capacity of (at least) `size` bytes.
+ */
+void *fio_buffer_borrow(size_t size) {
+  const size_t c = fio_buffer_class(size);
+  fio_buffer_s *b;
+  if (c < FIO_BUFFER_POOL_CLASSES) {
+    b = fio_buffer_list_pop(fio_buffer_cache + c);
+    if (b)
+      return (void *)(b + 1);
+    fio_lock(&fio_buffer_pool[c].lock);
+    b = fio_buffer_list_pop(&fio_buffer_pool[c].list);
+    fio_unlock(&fio_buffer_pool[c].lock);
+    if (b)
+      return (void *)(b + 1);
+    size = (size_t)1 << (FIO_BUFFER_POOL_MIN_BITS + c);
+  } else {
+    size = (size + 4095) & (~(size_t)4095);
+  }
+  b = fio_malloc(sizeof(*b) + size);
+  if (!b)
+    return NULL;
+  b->capa = size;
+  return (void *)(b + 1);
+}
+
+/**
+ * Returns a buffer to the pool.
+ */
+void fio_buffer_return(void *buffer) {
+  if (!buffer)
+    return;
+  fio_buffer_s *b = (fio_buffer_s *)buffer - 1;
+  const size_t c = fio_buffer_class(b->capa);
+  if (c >= FIO_BUFFER_POOL_CLASSES)
+    goto release;
+  if (fio_buffer_cache[c].count < FIO_BUFFER_POOL_CACHE) {
+    fio_buffer_list_push(fio_buffer_cache + c, b);
+    return;
+  }
+  fio_lock(&fio_buffer_pool[c].lock);
+  if (fio_buffer_pool[c].list.count < FIO_BUFFER_POOL_LIMIT) {
+    fio_buffer_list_push(&fio_buffer_pool[c].list, b);
+    b = NULL;
+  }
+  fio_unlock(&fio_buffer_pool[c].lock);
+  if (!b)
+    return;
+release:
+  fio_free(b);
+}
+
+/**
+ * Returns the capacity of a buffer returned by `fio_buffer_borrow`.
+ */
+size_t fio_buffer_capacity(void *buffer) {
+  if (!buffer)
+    return 0;
+  return ((fio_buffer_s *)buffer - 1)->capa;
+}
+
+/* moves the calling thread's cached buffers to the shared pool */
+static void fio_buffer_cache_flush(void) {
+  for (size_t c = 0; c < FIO_BUFFER_POOL_CLASSES; ++c) {
+    fio_buffer_s *b;
+    while ((b = fio_buffer_list_pop(fio_buffer_cache + c))) {
+      fio_lock(&fio_buffer_pool[c].lock);
+      if (fio_buffer_pool[c].list.count < FIO_BUFFER_POOL_LIMIT) {
+        fio_buffer_list_push(&fio_buffer_pool[c].list, b);
+        b = NULL;
+      }
+      fio_unlock(&fio_buffer_pool[c].lock);
+      fio_free(b);
+    }
+  }
+}
+
+/* releases all pooled buffers (the calling thread's cache included) */
+static void fio_buffer_pool_clear(void) {
+  for (size_t c = 0; c < FIO_BUFFER_POOL_CLASSES; ++c) {
+    fio_buffer_s *b;
+    while ((b = fio_buffer_list_pop(fio_buffer_cache + c)))
+      fio_free(b);
+    fio_lock(&fio_buffer_pool[c].lock);
+    while ((b = fio_buffer_list_pop(&fio_buffer_pool[c].list)))
+      fio_free(b);
+    fio_unlock(&fio_buffer_pool[c].lock);
+  }
+}
+
+static void fio_buffer_pool_on_fork(void) {
+  for (size_t c = 0; c < FIO_BUFFER_POOL_CLASSES; ++c)
+    fio_buffer_pool[c].lock = FIO_LOCK_INIT;
+}
+
+/* *****************************************************************************
+Connection Splicing (forwarding data between two connections)
+***************************************************************************** */
+
+typedef struct fio_splice_s fio_splice_s;
+
+/* a tunnel side, forwarding the data read from `uuid` to the peer */
+typedef struct {
+  fio_protocol_s pr;
+  fio_splice_s *tunnel;
+  intptr_t uuid;
+  /* data read but not yet sent to the peer (-1 when copying the data) */
+  int pipe[2];
+  size_t pipe_len;
+  fio_lock_i lock;
+  /* set when reading was suspended until the peer can accept more data */
+  uint8_t suspended;
+} fio_splice_side_s;
+
+struct fio_splice_s {
+  fio_splice_side_s side[2];
+  void (*on_close)(void *udata);
+  void *udata;
+  size_t chunk;
+  volatile size_t ref;
+};
+
+#define fio_splice_peer(s) ((s)->tunnel->side + ((s) == (s)->tunnel->side))
+
+/* stops reading until the peer is ready for more data (call under lock) */
+static inline void fio_splice_suspend(fio_splice_side_s *s) {
+  s->suspended = 1;
+  fio_suspend(s->uuid);
+}
+
+/* resumes reading if it was suspended (call under lock) */
+static inline void fio_splice_resume(fio_splice_side_s *s) {
+  if (!s->suspended)
+    return;
+  s->suspended = 0;
+  fio_force_event(s->uuid, FIO_EVENT_ON_DATA);
+}
+
+/* moves piped data to the peer, unless the peer has queued packets */
+static void fio_splice_drain(fio_splice_side_s *s) {
+#if FIO_SPLICE
+  const intptr_t peer = fio_splice_peer(s)->uuid;
+  const int fd = fio_uuid2fd(peer);
+  ssize_t sent;
+  if (!s->pipe_len)
+    return;
+  fio_lock(&fd_data(fd).sock_lock);
+  if (fd2uuid(fd) != peer || fd_data(fd).close) {
+    fio_unlock(&fd_data(fd).sock_lock);
+    return;
+  }
+  if (fd_data(fd).packet) {
+    /* keep the queued packets in order, `on_ready` will drain the pipe */
+    fio_unlock(&fd_data(fd).sock_lock);
+    return;
+  }
+  fio_edge_write_begin(fd);
+retry_int:
+  sent = splice(s->pipe[0], NULL, fd, NULL, s->pipe_len,
+                SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+  if (sent < 0 && errno == EINTR)
+    goto retry_int;
+  if (sent > 0)
+    fio_edge_write_done(fd);
+  fio_unlock(&fd_data(fd).sock_lock);
+  if (sent > 0) {
+    s->pipe_len -= sent;
+    fio_stats_add(bytes_written, sent);
+    touchfd(fd);
+    if (!s->pipe_len)
+      return;
+  } else if (sent < 0 && errno != EWOULDBLOCK && errno != EAGAIN) {
+    fio_force_close(peer);
+    return;
+  }
+  /* wait for the peer to become writable */
+  fio_poll_add_write(fd);
+#else
+  (void)s;
+#endif
+}
+
+/* reads data from the connection using `splice` (zero-copy) */
+static void fio_splice_read_pipe(fio_splice_side_s *s) {
+#if FIO_SPLICE
+  ssize_t got;
+retry_int:
+  fio_stats_add(read_calls, 1);
+  got = splice(fio_uuid2fd(s->uuid), NULL, s->pipe[1], NULL, s->tunnel->chunk,
+               SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+  if (got > 0) {
+    fio_edge_read_more(fio_uuid2fd(s->uuid), (size_t)got == s->tunnel->chunk);
+    s->pipe_len += got;
+    fio_stats_add(bytes_read, got);
+    fio_touch(s->uuid);
+    fio_splice_drain(s);
+    return;
+  }
+  if (got < 0 && errno == EINTR)
+    goto retry_int;
+  if (got < 0 && (errno == EWOULDBLOCK || errno == EAGAIN)) {
+    fio_edge_read_more(fio_uuid2fd(s->uuid), 0);
+    return;
+  }
+  /* EOF or a connection error */
+  fio_force_close(s->uuid);
+#else
+  (void)s;
+#endif
+}
+
+/* reads data from the connection and queues a copy for the peer */
+static void fio_splice_read_copy(fio_splice_side_s *s) {
+  void *buf = fio_buffer_borrow(s->tunnel->chunk);
+  if (!buf) {
+    fio_close(s->uuid);
+    return;
+  }
+  ssize_t got = fio_read(s->uuid, buf, fio_buffer_capacity(buf));
+  if (got > 0)
+    fio_write(fio_splice_peer(s)->uuid, buf, got);
+  fio_buffer_return(buf);
+}
+
+static void fio_splice_on_data(intptr_t uuid, fio_protocol_s *pr) {
+  fio_splice_side_s *s = (fio_splice_side_s *)pr;
+  fio_lock(&s->lock);
+  if (s->pipe[0] == -1) {
+    if (fio_is_congested(fio_splice_peer(s)->uuid)) {
+      fio_splice_suspend(s);
+      /* the peer might have drained before `on_drained` could be scheduled */
+      if (!fio_is_congested(fio_splice_peer(s)->uuid))
+        fio_splice_resume(s);
+    } else {
+      fio_splice_read_copy(s);
+    }
+  } else {
+    fio_splice_drain(s);
+    if (!s->pipe_len)
+      fio_splice_read_pipe(s);
+    if (s->pipe_len)
+      fio_splice_suspend(s);
+  }
+  fio_unlock(&s->lock);
+  (void)uuid;
+}
+
+/* the connection is writable, drain any data piped for it by the peer */
+static void fio_splice_on_ready(intptr_t uuid, fio_protocol_s *pr) {
+  fio_splice_side_s *peer = fio_splice_peer((fio_splice_side_s *)pr);
+  fio_lock(&peer->lock);
+  if (peer->pipe[0] == -1) {
+    /* copying - `on_drained` might have been skipped (coalesced) */
+    if (!fio_is_congested(uuid))
+      fio_splice_resume(peer);
+  } else {
+    fio_splice_drain(peer);
+    if (!peer->pipe_len)
+      fio_splice_resume(peer);
+  }
+  fio_unlock(&peer->lock);
+}
+
+/* the connection's outgoing queue drained, resume copying data to it */
+static void fio_splice_on_drained(intptr_t uuid, fio_protocol_s *pr) {
+  fio_splice_side_s *peer = fio_splice_peer((fio_splice_side_s *)pr);
+  fio_lock(&peer->lock);
+  fio_splice_resume(peer);
+  fio_unlock(&peer->lock);
+  (void)uuid;
+}
+
+static void fio_splice_on_close(intptr_t uuid, fio_protocol_s *pr) {
+  fio_splice_side_s *s = (fio_splice_side_s *)pr;
+  fio_splice_s *t = s->tunnel;
+  const intptr_t peer = fio_splice_peer(s)->uuid;
+  fio_lock(&s->lock);
+  /* data read before the connection closed is queued for the peer */
+  while (s->pipe_len) {
+    void *buf = fio_buffer_borrow(s->pipe_len);
+    ssize_t got = buf ? read(s->pipe[0], buf, fio_buffer_capacity(buf)) : -1;
+    if (got > 0)
+      fio_write(peer, buf, got);
+    fio_buffer_return(buf);
+    if (got <= 0)
+      break;
+    s->pipe_len -= got;
+  }
+  fio_unlock(&s->lock);
+  fio_close(peer);
+  if (fio_atomic_sub(&t->ref, 1))
+    return;
+  for (size_t i = 0; i < 2; ++i) {
+    if (t->side[i].pipe[0] == -1)
+      continue;
+    close(t->side[i].pipe[0]);
+    close(t->side[i].pipe[1]);
+  }
+  if (t->on_close)
+    t->on_close(t->udata);
+  fio_free(t);
+  (void)uuid;
+}
+
+/**
+ * Forwards data between two connections, in both directions, until either
+ * connection closes.
+ */
+int fio_splice FIO_IGNORE_MACRO(intptr_t uuid_a, intptr_t uuid_b,
+                                struct fio_splice_args args) {
+  if (!uuid_is_valid(uuid_a) || !uuid_is_valid(uuid_b) || uuid_a == uuid_b) {
+    errno = EBADF;
+    return -1;
+  }
+  if (!args.chunk)
+    args.chunk = FIO_SPLICE_CHUNK;
+  fio_splice_s *t = fio_malloc(sizeof(*t));
+  FIO_ASSERT_ALLOC(t);
+  *t = (fio_splice_s){
+      .on_close = args.on_close,
+      .udata = args.udata,
+      .chunk = args.chunk,
+      .ref = 2,
+  };
+  const intptr_t uuids[2] = {uuid_a, uuid_b};
+  /* `splice` requires the system's read / write (no TLS hooks) on both ends */
+  uint8_t piped = FIO_SPLICE &&
+                  uuid_data(uuid_a).rw_hooks == &FIO_DEFAULT_RW_HOOKS &&
+                  uuid_data(uuid_b).rw_hooks == &FIO_DEFAULT_RW_HOOKS;
+  for (size_t i = 0; i < 2; ++i) {
+    t->side[i] = (fio_splice_side_s){
+        .pr =
+            {
+                .on_data = fio_splice_on_data,
+                .on_ready = fio_splice_on_ready,
+                .on_close = fio_splice_on_close,
+                .on_drained = fio_splice_on_drained,
+            },
+        .tunnel = t,
+        .uuid = uuids[i],
+        .pipe = {-1, -1},
+        .lock = FIO_LOCK_INIT,
+    };
+    if (piped && pipe(t->side[i].pipe)) {
+      t->side[i].pipe[0] = t->side[i].pipe[1] = -1;
+      piped = 0;
+    }
+  }
+  for (size_t i = 0; piped && i < 2; ++i) {
+    if (fio_set_non_block(t->side[i].pipe[0]) == -1 ||
+        fio_set_non_block(t->side[i].pipe[1]) == -1)
+      piped = 0;
+  }
+  if (!piped) {
+    /* fall back to copying the data (for both directions) */
+    for (size_t i = 0; i < 2; ++i) {
+      if (t->side[i].pipe[0] == -1)
+        continue;
+      close(t->side[i].pipe[0]);
+      close(t->side[i].pipe[1]);
+      t->side[i].pipe[0] = t->side[i].pipe[1] = -1;
+    }
+  }
+  fio_attach(uuid_a, &t->side[0].pr);
+  fio_attach(uuid_b, &t->side[1].pr);
+  return 0;
+}
+
 /* *****************************************************************************
 Section Start Marker
 
@@ -3235,8 +6259,16 @@ static int fio_attach__internal(void *uuid_, void *protocol_) {
   fio_protocol_s *old_pr = uuid_data(uuid).protocol;
   uuid_data(uuid).open = 1;
   uuid_data(uuid).protocol = protocol;
+  if (!old_pr && protocol) {
+    uuid_cold(uuid).watermark_high = FIO_WATERMARK_HIGH;
+    uuid_cold(uuid).watermark_low = FIO_WATERMARK_LOW;
+  }
   touchfd(fio_uuid2fd(uuid));
+  if (protocol)
+    fio_timeout_schedule(fio_uuid2fd(uuid));
   fio_unlock(&uuid_data(uuid).protocol_lock);
+  if (protocol && protocol->watermark_high)
+    fio_watermarks_set(uuid, protocol->watermark_high, protocol->watermark_low);
   if (old_pr) {
     /* protocol replacement */
     fio_defer_push_task(deferred_on_close, (void *)uuid, old_pr);
@@ -3284,6 +6316,8 @@ void fio_timeout_set(intptr_t uuid, uint8_t timeout) {
   if (uuid_is_valid(uuid)) {
     touchfd(fio_uuid2fd(uuid));
     uuid_data(uuid).timeout = timeout;
+    if (uuid_data(uuid).protocol)
+      fio_timeout_schedule(fio_uuid2fd(uuid));
   } else {
     FIO_LOG_DEBUG("Called fio_timeout_set for invalid uuid %p", (void *)uuid);
   }
@@ -3292,6 +6326,61 @@ void fio_timeout_set(intptr_t uuid, uint8_t timeout) {
  * timeout or the connection is inactive. */
 uint8_t fio_timeout_get(intptr_t uuid) { return uuid_data(uuid).timeout; }
 
+/** Sets a connection's `on_data` CPU budget (microseconds per cycle). */
+void fio_budget_set(intptr_t uuid, uint32_t microseconds) {
+  if (uuid_is_valid(uuid)) {
+    uuid_data(uuid).budget = microseconds;
+    uuid_data(uuid).budget_used = 0;
+  } else {
+    FIO_LOG_DEBUG("Called fio_budget_set for invalid uuid %p", (void *)uuid);
+  }
+}
+/** Gets a connection's `on_data` CPU budget. Returns 0 if none. */
+uint32_t fio_budget_get(intptr_t uuid) {
+  if (!uuid_is_valid(uuid))
+    return 0;
+  return uuid_data(uuid).budget;
+}
+
+/** Sets a connection's outgoing queue watermarks (in bytes). */
+void fio_watermarks_set(intptr_t uuid, size_t high, size_t low) {
+  if (!uuid_is_valid(uuid)) {
+    FIO_LOG_DEBUG("Called fio_watermarks_set for invalid uuid %p",
+                  (void *)uuid);
+    return;
+  }
+  if (low > high)
+    low = high;
+  uint8_t changed = 0;
+  fio_lock(&uuid_data(uuid).sock_lock);
+  uuid_cold(uuid).watermark_high = high;
+  uuid_cold(uuid).watermark_low = low;
+  if (!high || uuid_cold(uuid).pending_bytes <= low) {
+    changed = uuid_cold(uuid).congested;
+    uuid_cold(uuid).congested = 0;
+  } else if (uuid_cold(uuid).pending_bytes > high) {
+    changed = !uuid_cold(uuid).congested;
+    uuid_cold(uuid).congested = 1;
+  }
+  fio_unlock(&uuid_data(uuid).sock_lock);
+  if (changed)
+    fio_defer_push_task(deferred_on_congestion, (void *)uuid, NULL);
+}
+
+/** Returns the number of bytes waiting in a connection's outgoing queue. */
+size_t fio_pending_bytes(intptr_t uuid) {
+  if (!uuid_is_valid(uuid))
+    return 0;
+  return uuid_cold(uuid).pending_bytes;
+}
+
+/** Returns true if a connection's outgoing queue is congested. */
+int fio_is_congested(intptr_t uuid) {
+  if (!uuid_is_valid(uuid))
+    return 0;
+  return uuid_cold(uuid).congested;
+}
+
 /* *****************************************************************************
 Core Callbacks for forking / starting up / cleaning up
 ***************************************************************************** */
@@ -3503,14 +6592,17 @@ static void fio_pubsub_on_fork(void);
 
 /* Called within a child process after it starts. */
 static void fio_on_fork(void) {
-  fio_timer_lock = FIO_LOCK_INIT;
+  fio_timer_lock = FIO_MUTEX_INIT;
+  fio_buffer_pool_on_fork();
+  memset(fio_stats_slots, 0, sizeof(fio_stats_slots));
+  fio_histogram_clear();
   fio_data->lock = FIO_LOCK_INIT;
   fio_defer_on_fork();
   fio_malloc_after_fork();
   fio_poll_init();
   fio_state_callback_on_fork();
 
-  const size_t limit = fio_data->capa;
+  const size_t limit = fio_data->fd_limit;
   for (size_t i = 0; i < limit; ++i) {
     fd_data(i).sock_lock = FIO_LOCK_INIT;
     fd_data(i).protocol_lock = FIO_LOCK_INIT;
@@ -3541,6 +6633,8 @@ static void __attribute__((destructor)) fio_lib_destroy(void) {
   fio_state_callback_clear_all();
   fio_defer_perform();
   fio_poll_close();
+  fio_buffer_pool_clear();
+  fio_fd_data_destroy();
   fio_free(fio_data);
   /* memory library destruction must be last */
   fio_mem_destroy();
@@ -3550,6 +6644,17 @@ static void __attribute__((destructor)) fio_lib_destroy(void) {
     fprintf(stderr, "\n"); /* add EOL to logs (logging adds EOL before text */
 }
 
+/* the memory required by `fio_data` beyond it's fixed size */
+#if FIO_ENGINE_POLL
+#define FIO_FD_DATA_EXTRA(capa)                                                \
+  ((sizeof(*fio_data->pages) * (((capa) + FIO_FD_PAGE_MASK) >>                 \
+                                FIO_FD_PAGE_BITS)) +                           \
+   (sizeof(*fio_data->poll) * (capa)))
+#else
+#define FIO_FD_DATA_EXTRA(capa)                                                \
+  (sizeof(*fio_data->pages) * (((capa) + FIO_FD_PAGE_MASK) >> FIO_FD_PAGE_BITS))
+#endif
+
 static void fio_mem_init(void);
 static void fio_cluster_init(void);
 static void fio_pubsub_initialize(void);
@@ -3574,7 +6679,7 @@ static void __attribute__((constructor)) fio_lib_init(void) {
         rlim.rlim_cur = rlim.rlim_max = FIO_MAX_SOCK_CAPACITY;
       }
       while (setrlimit(RLIMIT_NOFILE, &rlim) == -1 && rlim.rlim_cur > original)
-        --rlim.rlim_cur;
+        rlim.rlim_cur -= ((rlim.rlim_cur - original) >> 4) + 1;
       getrlimit(RLIMIT_NOFILE, &rlim);
       capa = rlim.rlim_cur;
       if (capa > 1024) /* leave a slice of room */
@@ -3583,56 +6688,35 @@ static void __attribute__((constructor)) fio_lib_init(void) {
     /* initialize memory allocator */
     fio_mem_init();
     /* initialize polling engine */
-    fio_poll_init();
-    /* initialize the cluster engine */
-    fio_pubsub_initialize();
-#if DEBUG
-#if FIO_ENGINE_POLL
-    FIO_LOG_INFO("facil.io " FIO_VERSION_STRING " capacity initialization:\n"
-                 "*    Meximum open files %zu out of %zu\n"
-                 "*    Allocating %zu bytes for state handling.\n"
-                 "*    %zu bytes per connection + %zu for state handling.",
-                 capa, (size_t)rlim.rlim_max,
-                 (sizeof(*fio_data) + (capa * (sizeof(*fio_data->poll))) +
-                  (capa * (sizeof(*fio_data->info)))),
-                 (sizeof(*fio_data->poll) + sizeof(*fio_data->info)),
-                 sizeof(*fio_data));
-#else
+    fio_poll_init();
+    /* initialize the cluster engine */
+    fio_pubsub_initialize();
+#if DEBUG
     FIO_LOG_INFO("facil.io " FIO_VERSION_STRING " capacity initialization:\n"
                  "*    Meximum open files %zu out of %zu\n"
                  "*    Allocating %zu bytes for state handling.\n"
-                 "*    %zu bytes per connection + %zu for state handling.",
+                 "*    %zu bytes per connection (allocated %zu at a time).",
                  capa, (size_t)rlim.rlim_max,
-                 (sizeof(*fio_data) + (capa * (sizeof(*fio_data->info)))),
-                 (sizeof(*fio_data->info)), sizeof(*fio_data));
-#endif
+                 (sizeof(*fio_data) + FIO_FD_DATA_EXTRA(capa)),
+                 sizeof(fio_fd_data_s), (size_t)FIO_FD_PAGE_SIZE);
 #endif
   }
 
-#if FIO_ENGINE_POLL
-  /* allocate and initialize main data structures by detected capacity */
-  fio_data = fio_mmap(sizeof(*fio_data) + (capa * (sizeof(*fio_data->poll))) +
-                      (capa * (sizeof(*fio_data->info))));
+  /* allocate the main data structure, connection data is allocated on demand */
+  fio_data = fio_mmap(sizeof(*fio_data) + FIO_FD_DATA_EXTRA(capa));
   FIO_ASSERT_ALLOC(fio_data);
   fio_data->capa = capa;
+#if FIO_ENGINE_POLL
   fio_data->poll =
-      (void *)((uintptr_t)(fio_data + 1) + (sizeof(fio_data->info[0]) * capa));
-#else
-  /* allocate and initialize main data structures by detected capacity */
-  fio_data = fio_mmap(sizeof(*fio_data) + (capa * (sizeof(*fio_data->info))));
-  FIO_ASSERT_ALLOC(fio_data);
-  fio_data->capa = capa;
+      (void *)((uintptr_t)(fio_data + 1) +
+               (sizeof(*fio_data->pages) *
+                ((capa + FIO_FD_PAGE_MASK) >> FIO_FD_PAGE_BITS)));
 #endif
   fio_data->parent = getpid();
   fio_data->connection_count = 0;
   fio_mark_time();
-
-  for (ssize_t i = 0; i < capa; ++i) {
-    fio_clear_fd(i, 0);
-#if FIO_ENGINE_POLL
-    fio_data->poll[i].fd = -1;
-#endif
-  }
+  /* the first page covers the standard IO and the polling file descriptors */
+  fio_fd_data_reserve(0);
 
   /* call initialization callbacks */
   fio_state_callback_force(FIO_CALL_ON_INITIALIZE);
@@ -3671,47 +6755,64 @@ Section Start Marker
 
 static void fio_cluster_signal_children(void);
 
-static void fio_review_timeout(void *arg, void *ignr) {
-  // TODO: Fix review for connections with no protocol?
-  (void)ignr;
-  fio_protocol_s *tmp;
-  time_t review = fio_data->last_cycle.tv_sec;
-  intptr_t fd = (intptr_t)arg;
+/* reviews the connections in a timeout bucket, pinging expired connections */
+static void fio_review_timeout_bucket(fio_ls_embd_s *bucket, time_t review) {
+  fio_ls_embd_s list = FIO_LS_INIT(list);
+  if (!fio_ls_embd_any(bucket))
+    return;
+  /* move the bucket's nodes aside, as connections might be placed back */
+  list.next = bucket->next;
+  list.prev = bucket->prev;
+  list.next->prev = &list;
+  list.prev->next = &list;
+  *bucket = (fio_ls_embd_s)FIO_LS_INIT(*bucket);
+  while (fio_ls_embd_any(&list)) {
+    fio_ls_embd_s *node = fio_ls_embd_shift(&list);
+    intptr_t fd = FIO_LS_EMBD_OBJ(fio_fd_cold_s, timeout_node, node)->fd;
+    fio_protocol_s *tmp;
+    if (!fd_data(fd).protocol)
+      continue; /* the connection was hijacked, stop reviewing */
+    if (fio_timeout_due(fd) >= review)
+      goto reschedule; /* the connection was active, lazy bucket update */
+    tmp = protocol_try_lock(fd, FIO_PR_LOCK_STATE);
+    if (!tmp) {
+      if (errno == EBADF)
+        continue;
+      goto reschedule;
+    }
+    if (!prt_meta(tmp).locks[FIO_PR_LOCK_TASK] &&
+        !prt_meta(tmp).locks[FIO_PR_LOCK_WRITE])
+      fio_defer_push_task(deferred_ping, (void *)fd2uuid(fd), NULL);
+    protocol_unlock(tmp, FIO_PR_LOCK_STATE);
+  reschedule:
+    fio_timeout_schedule_unsafe(fd);
+  }
+}
 
-  uint16_t timeout = fd_data(fd).timeout;
-  if (!timeout)
-    timeout = 300; /* enforced timout settings */
-  if (!fd_data(fd).protocol || (fd_data(fd).active + timeout >= review))
+/* reviews connection timeouts, visiting only the buckets that expired */
+static void fio_review_timeout(void) {
+  const time_t review = fio_data->last_cycle.tv_sec;
+  fio_lock(&fio_timeouts.lock);
+  if (!fio_timeouts.initialized || fio_timeouts.reviewed >= review)
     goto finish;
-  tmp = protocol_try_lock(fd, FIO_PR_LOCK_STATE);
-  if (!tmp) {
-    if (errno == EBADF)
-      goto finish;
-    goto reschedule;
-  }
-  if (prt_meta(tmp).locks[FIO_PR_LOCK_TASK] ||
-      prt_meta(tmp).locks[FIO_PR_LOCK_WRITE])
-    goto unlock;
-  fio_defer_push_task(deferred_ping, (void *)fio_fd2uuid((int)fd), NULL);
-unlock:
-  protocol_unlock(tmp, FIO_PR_LOCK_STATE);
-finish:
-  do {
-    fd++;
-  } while (!fd_data(fd).protocol && (fd <= fio_data->max_protocol_fd));
-
-  if (fio_data->max_protocol_fd < fd) {
-    fio_data->need_review = 1;
-    return;
+  time_t pos = fio_timeouts.reviewed;
+  if (review - pos > FIO_TIMEOUT_BUCKETS)
+    pos = review - FIO_TIMEOUT_BUCKETS;
+  /* rescheduled connections are placed after the reviewed period */
+  fio_timeouts.reviewed = review;
+  while (pos < review) {
+    ++pos;
+    fio_review_timeout_bucket(
+        fio_timeouts.buckets + ((uintptr_t)pos & (FIO_TIMEOUT_BUCKETS - 1)),
+        review);
   }
-reschedule:
-  fio_defer_push_task(fio_review_timeout, (void *)fd, NULL);
+finish:
+  fio_unlock(&fio_timeouts.lock);
 }
 
 /* reactor pattern cycling - common actions */
 static void fio_cycle_schedule_events(void) {
   static int idle = 0;
-  static time_t last_to_review = 0;
   fio_mark_time();
   fio_timer_schedule();
   fio_max_fd_shrink();
@@ -3720,7 +6821,10 @@ static void fio_cycle_schedule_events(void) {
     fio_signal_children_flag = 0;
     fio_cluster_signal_children();
   }
-  int events = fio_poll();
+  const uint64_t poll_start = fio_histogram_now();
+  int events = (int)fio_stats_poll(fio_poll(), poll_start);
+  /* connections over budget are placed after the new events */
+  fio_defer_release_postponed();
   if (events < 0) {
     return;
   }
@@ -3733,11 +6837,7 @@ static void fio_cycle_schedule_events(void) {
       idle = 0;
     }
   }
-  if (fio_data->need_review && fio_data->last_cycle.tv_sec != last_to_review) {
-    last_to_review = fio_data->last_cycle.tv_sec;
-    fio_data->need_review = 0;
-    fio_defer_push_task(fio_review_timeout, (void *)0, NULL);
-  }
+  fio_review_timeout();
 }
 
 /* reactor pattern cycling during cleanup */
@@ -3761,6 +6861,35 @@ static void fio_cycle(void *ignr, void *ignr2) {
   return;
 }
 
+/* reactor per thread mode - each thread polls and handles it's own events */
+static void *fio_reactor_thread_cycle(void *index_) {
+  const size_t index = (size_t)index_;
+  int throttle = 0; /* milliseconds, grows while idle */
+  fio_affinity_pin_thread(index);
+  fio_defer_on_thread_start();
+  fio_poll_thread_own(index);
+  for (;;) {
+    fio_defer_perform();
+    if (!fio_is_running())
+      break;
+    if (!index) {
+      /* the first thread also performs the reactor cycle's common actions */
+      fio_cycle_schedule_events();
+      continue;
+    }
+    const uint64_t poll_start = fio_histogram_now();
+    if (fio_stats_poll(fio_poll_thread(throttle), poll_start) ||
+        fio_defer_has_queue())
+      throttle = 0;
+    else if (throttle < (int)(FIO_DEFER_THROTTLE_LIMIT >> 20))
+      throttle = (throttle << 1) | 1;
+  }
+  fio_poll_thread_own((size_t)-1);
+  fio_buffer_cache_flush();
+  fio_defer_on_thread_end();
+  return index_;
+}
+
 /* TODO: fixme */
 static void fio_worker_startup(void) {
   /* Call the on_start callbacks for worker processes. */
@@ -3778,18 +6907,38 @@ static void fio_worker_startup(void) {
   } else {
     /* Root Process should run in single thread mode */
     fio_data->threads = 1;
+    fio_data->max_threads = 0;
   }
 
-  /* require timeout review */
-  fio_data->need_review = 1;
+  if (fio_data->is_worker)
+    fio_affinity_pin_worker(fio_data->worker_id);
+
+#if FIO_HISTOGRAM_LOG_INTERVAL
+  if (fio_data->is_worker)
+    fio_run_every(FIO_HISTOGRAM_LOG_INTERVAL, 0, fio_histogram_log_task, NULL,
+                  NULL);
+#endif
+
+  if (fio_data->threads > 1 && fio_data->reactor_per_thread) {
+    if (!fio_poll_threads_init(fio_data->threads)) {
+      FIO_LOG_DEBUG("(%d) running a reactor per thread (%u threads)",
+                    (int)getpid(), (unsigned)fio_data->threads);
+      fio_defer_thread_pool_join(fio_defer_thread_pool_new2(
+          fio_data->threads, fio_reactor_thread_cycle));
+      fio_poll_threads_destroy();
+      return;
+    }
+    FIO_LOG_WARNING("reactor per thread mode unavailable (requires epoll).");
+  }
 
   /* the cycle task will loop by re-scheduling until it's time to finish */
   fio_defer_push_task(fio_cycle, NULL, NULL);
 
-  /* A single thread doesn't need a pool. */
-  if (fio_data->threads > 1) {
+  /* A single thread doesn't need a pool (unless it might grow). */
+  if (fio_data->threads > 1 || fio_data->max_threads) {
     fio_defer_thread_pool_join(fio_defer_thread_pool_new(fio_data->threads));
   } else {
+    fio_affinity_pin_thread(0);
     fio_defer_perform();
   }
 }
@@ -3832,6 +6981,147 @@ static void fio_worker_cleanup(void) {
   }
 }
 
+/* *****************************************************************************
+CPU Affinity (pinning workers and threads to CPU cores)
+***************************************************************************** */
+#if FIO_AFFINITY
+
+/* the CPU cores available to the current worker process */
+static cpu_set_t fio_affinity_set;
+static size_t fio_affinity_count;
+
+/* parses a sysfs CPU list file (i.e., "0-3,8-11"), returning the CPU count */
+static size_t fio_affinity_read_list(const char *path, cpu_set_t *set) {
+  char buf[1024];
+  size_t count = 0;
+  int fd = open(path, O_RDONLY);
+  if (fd == -1)
+    return 0;
+  ssize_t len = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (len <= 0)
+    return 0;
+  buf[len] = 0;
+  CPU_ZERO(set);
+  char *pos = buf;
+  while (*pos >= '0' && *pos <= '9') {
+    size_t first = (size_t)fio_atol(&pos);
+    size_t last = first;
+    if (*pos == '-') {
+      ++pos;
+      last = (size_t)fio_atol(&pos);
+    }
+    for (; first <= last && first < CPU_SETSIZE; ++first) {
+      CPU_SET(first, set);
+      ++count;
+    }
+    if (*pos == ',')
+      ++pos;
+  }
+  return count;
+}
+
+/* returns the number of NUMA nodes (0 if the topology is unknown) */
+static size_t fio_affinity_numa_nodes(void) {
+  char path[64];
+  size_t nodes = 0;
+  for (;;) {
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%zu", nodes);
+    if (access(path, F_OK))
+      return nodes;
+    ++nodes;
+  }
+}
+
+/*
+ * Pins a worker process to a set of CPU cores.
+ *
+ * When the machine has more than a single NUMA node, every worker is pinned to
+ * a node (round robin). Otherwise, the available cores are split between the
+ * workers.
+ */
+static void fio_affinity_pin_worker(size_t id) {
+  if (sched_getaffinity(0, sizeof(fio_affinity_set), &fio_affinity_set)) {
+    FIO_LOG_WARNING("(%d) couldn't read the CPU affinity mask.", (int)getpid());
+    fio_affinity_count = 0;
+    return;
+  }
+  fio_affinity_count = CPU_COUNT(&fio_affinity_set);
+  if (!fio_data->pin_workers || fio_data->workers <= 1 || !fio_affinity_count)
+    return;
+  cpu_set_t set;
+  const size_t nodes = fio_affinity_numa_nodes();
+  CPU_ZERO(&set);
+  if (nodes > 1) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%zu/cpulist",
+             id % nodes);
+    if (fio_affinity_read_list(path, &set))
+      CPU_AND(&set, &set, &fio_affinity_set);
+  }
+  if (!CPU_COUNT(&set)) {
+    /* split the available cores into (roughly) equal slices */
+    size_t per_worker = fio_affinity_count / fio_data->workers;
+    size_t first = per_worker ? id * per_worker : id % fio_affinity_count;
+    if (!per_worker)
+      per_worker = 1;
+    for (size_t cpu = 0, i = 0; cpu < CPU_SETSIZE && i < first + per_worker;
+         ++cpu) {
+      if (!CPU_ISSET(cpu, &fio_affinity_set))
+        continue;
+      if (i >= first)
+        CPU_SET(cpu, &set);
+      ++i;
+    }
+  }
+  if (sched_setaffinity(0, sizeof(set), &set)) {
+    FIO_LOG_WARNING("(%d) couldn't set the CPU affinity mask.", (int)getpid());
+    return;
+  }
+  fio_affinity_set = set;
+  fio_affinity_count = CPU_COUNT(&set);
+  FIO_LOG_DEBUG("(%d) worker pinned to %zu CPU cores%s", (int)getpid(),
+                fio_affinity_count, (nodes > 1 ? " (NUMA node)" : ""));
+}
+
+/* pins the calling thread to a single CPU core of the worker's core set */
+static void fio_affinity_pin_thread(size_t index) {
+  if (!fio_data || !fio_data->pin_threads || !fio_affinity_count)
+    return;
+  size_t target = index % fio_affinity_count;
+  for (size_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (!CPU_ISSET(cpu, &fio_affinity_set) || target--)
+      continue;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set)) {
+      FIO_LOG_WARNING("(%d) couldn't pin thread to CPU %zu.", (int)getpid(),
+                      cpu);
+      return;
+    }
+    /* align the thread's allocation arena with the CPU core */
+    fio_mem_arena_bind(cpu);
+    return;
+  }
+}
+
+#else
+
+static void fio_affinity_pin_worker(size_t id) {
+  if (fio_data->pin_workers || fio_data->pin_threads)
+    FIO_LOG_WARNING("CPU affinity is unavailable on this system, ignored.");
+  (void)id;
+}
+
+static void fio_affinity_pin_thread(size_t index) { (void)index; }
+
+#endif /* FIO_AFFINITY */
+
+/* *****************************************************************************
+Worker Processes (forking and respawning)
+***************************************************************************** */
+
 static void fio_sentinel_task(void *arg1, void *arg2);
 static void *fio_sentinel_worker_thread(void *arg) {
   errno = 0;
@@ -3869,12 +7159,14 @@ static void *fio_sentinel_worker_thread(void *arg) {
         FIO_LOG_WARNING("Child worker (%d) shutdown. Respawning worker.",
                         (int)child);
       }
-      fio_defer_push_task(fio_sentinel_task, NULL, NULL);
+      /* the respawned worker takes over the crashed worker's index */
+      fio_defer_push_task(fio_sentinel_task, arg, NULL);
       fio_unlock(&fio_fork_lock);
     }
 #endif
   } else {
     fio_on_fork();
+    fio_data->worker_id = (uint16_t)(uintptr_t)arg;
     fio_state_callback_force(FIO_CALL_AFTER_FORK);
     fio_state_callback_force(FIO_CALL_IN_CHILD);
     fio_worker_startup();
@@ -3882,7 +7174,6 @@ static void *fio_sentinel_worker_thread(void *arg) {
     exit(0);
   }
   return NULL;
-  (void)arg;
 }
 
 static void fio_sentinel_task(void *arg1, void *arg2) {
@@ -3890,14 +7181,13 @@ static void fio_sentinel_task(void *arg1, void *arg2) {
     return;
   fio_state_callback_force(FIO_CALL_BEFORE_FORK);
   fio_lock(&fio_fork_lock); /* will wait for worker thread to release lock. */
-  void *thrd =
-      fio_thread_new(fio_sentinel_worker_thread, (void *)&fio_fork_lock);
+  /* the sentinel thread receives the worker's index */
+  void *thrd = fio_thread_new(fio_sentinel_worker_thread, arg1);
   fio_thread_free(thrd);
   fio_lock(&fio_fork_lock);   /* will wait for worker thread to release lock. */
   fio_unlock(&fio_fork_lock); /* release lock for next fork. */
   fio_state_callback_force(FIO_CALL_AFTER_FORK);
   fio_state_callback_force(FIO_CALL_IN_MASTER);
-  (void)arg1;
   (void)arg2;
 }
 
@@ -3913,11 +7203,23 @@ FIO_FUNC void fio_start_(void) {} /* marker for SublimeText3 jump feature */
  * SIGINT/SIGTERM is received).
  */
 void fio_start FIO_IGNORE_MACRO(struct fio_start_args args) {
+  fio_limits_log();
   fio_expected_concurrency(&args.threads, &args.workers);
   fio_signal_handler_setup();
 
   fio_data->workers = (uint16_t)args.workers;
   fio_data->threads = (uint16_t)args.threads;
+  fio_data->reactor_per_thread = args.reactor_per_thread;
+  fio_data->pin_workers = args.pin_workers;
+  fio_data->pin_threads = args.pin_threads;
+  fio_data->worker_id = 0;
+  /* `threads` was resolved by `fio_expected_concurrency` (no longer <= 0) */
+  fio_data->max_threads =
+      (args.max_threads > args.threads ? (uint16_t)args.max_threads : 0);
+  fio_data->grow_delay =
+      (args.grow_delay ? args.grow_delay : FIO_DEFER_POOL_GROW_DELAY);
+  fio_data->idle_timeout =
+      (args.idle_timeout ? args.idle_timeout : FIO_DEFER_POOL_IDLE_TIMEOUT);
   fio_data->active = 1;
   fio_data->is_worker = 0;
 
@@ -3935,7 +7237,7 @@ void fio_start FIO_IGNORE_MACRO(struct fio_start_args args) {
 
   if (args.workers > 1) {
     for (int i = 0; i < args.workers && fio_data->active; ++i) {
-      fio_sentinel_task(NULL, NULL);
+      fio_sentinel_task((void *)(uintptr_t)i, NULL);
     }
   }
   fio_worker_startup();
@@ -4485,6 +7787,8 @@ typedef struct {
   size_t port_len;
   size_t addr_len;
   void *tls;
+  uint32_t on_data_budget;
+  uint8_t reuse_port;
 } fio_listen_protocol_s;
 
 static void fio_listen_cleanup_task(void *pr_) {
@@ -4505,9 +7809,56 @@ static void fio_listen_cleanup_task(void *pr_) {
   free(pr_);
 }
 
+/*
+ * Listening sockets that use SO_REUSEPORT are only bound by `fio_listen`.
+ *
+ * Worker processes replace the inherited socket with their own listening
+ * socket, so the kernel balances incoming connections between the workers
+ * (rather than waking all of them). The root process keeps the bound socket
+ * in order to hold on to the port.
+ *
+ * Workers bind the port the root's socket is actually bound to (as reported by
+ * `getsockname`), so they never bind a different port than the root's.
+ */
+static void fio_listen_reuse_port(fio_listen_protocol_s *pr) {
+  if (!fio_is_master()) {
+    struct sockaddr_in6 addrinfo[2]; /* grab a slice of stack (aligned) */
+    socklen_t addrlen = sizeof(addrinfo);
+    char port[8];
+    intptr_t uuid = -1;
+    if (!getsockname(fio_uuid2fd(pr->uuid), (struct sockaddr *)addrinfo,
+                     &addrlen) &&
+        (addrinfo->sin6_family == AF_INET ||
+         addrinfo->sin6_family == AF_INET6)) {
+      /* `sin_port` and `sin6_port` share the same offset */
+      fio_ltoa(port, ntohs(addrinfo->sin6_port), 10);
+      uuid = fio_socket_internal(pr->addr_len ? pr->addr : NULL, port,
+                                 (FIO_SOCKET_SERVER | FIO_SOCKET_REUSE_PORT));
+    }
+    if (uuid != -1) {
+      fio_force_close(pr->uuid);
+      pr->uuid = uuid;
+      return;
+    }
+    FIO_LOG_WARNING("(%d) couldn't open a SO_REUSEPORT socket for port %s, "
+                    "sharing the root's socket.",
+                    (int)getpid(), pr->port);
+  }
+  /* single process mode (or fallback) - listen using the bound socket */
+  if (listen(fio_uuid2fd(pr->uuid), SOMAXCONN) < 0)
+    FIO_LOG_ERROR("(%d) couldn't listen on port %s", (int)getpid(), pr->port);
+}
+
 static void fio_listen_on_startup(void *pr_) {
   fio_state_callback_remove(FIO_CALL_ON_SHUTDOWN, fio_listen_cleanup_task, pr_);
   fio_listen_protocol_s *pr = pr_;
+  if (pr->reuse_port)
+    fio_listen_reuse_port(pr);
+#if FIO_ENGINE_EPOLL
+  else if (!fio_is_master())
+    /* the socket is shared by all the worker processes */
+    fio_poll_add_read_exclusive(fio_uuid2fd(pr->uuid));
+#endif
   fio_attach(pr->uuid, &pr->pr);
   if (pr->port_len)
     FIO_LOG_DEBUG("(%d) started listening on port %s", (int)getpid(), pr->port);
@@ -4521,34 +7872,49 @@ static void fio_listen_on_close(intptr_t uuid, fio_protocol_s *pr_) {
   (void)uuid;
 }
 
-static void fio_listen_on_data(intptr_t uuid, fio_protocol_s *pr_) {
-  fio_listen_protocol_s *pr = (fio_listen_protocol_s *)pr_;
-  for (int i = 0; i < 4; ++i) {
+/* accepts a batch of connections, returning the number of accepted clients */
+static size_t fio_listen_accept_batch(fio_listen_protocol_s *pr, intptr_t uuid,
+                                      intptr_t *clients) {
+  size_t count = 0;
+  while (count < FIO_LISTEN_ACCEPT_BATCH) {
     intptr_t client = fio_accept(uuid);
     if (client == -1)
-      return;
-    pr->on_open(client, pr->udata);
+      return count;
+    if (pr->on_data_budget)
+      uuid_data(client).budget = pr->on_data_budget;
+    clients[count++] = client;
+  }
+  /* the backlog might not be empty and the event won't repeat */
+  if (uuid_data(uuid).exclusive || FIO_POLL_EDGE)
+    fio_force_event(uuid, FIO_EVENT_ON_DATA);
+  return count;
+}
+
+static void fio_listen_on_data(intptr_t uuid, fio_protocol_s *pr_) {
+  fio_listen_protocol_s *pr = (fio_listen_protocol_s *)pr_;
+  intptr_t clients[FIO_LISTEN_ACCEPT_BATCH];
+  const size_t count = fio_listen_accept_batch(pr, uuid, clients);
+  for (size_t i = 0; i < count; ++i) {
+    pr->on_open(clients[i], pr->udata);
   }
 }
 
 static void fio_listen_on_data_tls(intptr_t uuid, fio_protocol_s *pr_) {
   fio_listen_protocol_s *pr = (fio_listen_protocol_s *)pr_;
-  for (int i = 0; i < 4; ++i) {
-    intptr_t client = fio_accept(uuid);
-    if (client == -1)
-      return;
-    fio_tls_accept(client, pr->tls, pr->udata);
-    pr->on_open(client, pr->udata);
+  intptr_t clients[FIO_LISTEN_ACCEPT_BATCH];
+  const size_t count = fio_listen_accept_batch(pr, uuid, clients);
+  for (size_t i = 0; i < count; ++i) {
+    fio_tls_accept(clients[i], pr->tls, pr->udata);
+    pr->on_open(clients[i], pr->udata);
   }
 }
 
 static void fio_listen_on_data_tls_alpn(intptr_t uuid, fio_protocol_s *pr_) {
   fio_listen_protocol_s *pr = (fio_listen_protocol_s *)pr_;
-  for (int i = 0; i < 4; ++i) {
-    intptr_t client = fio_accept(uuid);
-    if (client == -1)
-      return;
-    fio_tls_accept(client, pr->tls, pr->udata);
+  intptr_t clients[FIO_LISTEN_ACCEPT_BATCH];
+  const size_t count = fio_listen_accept_batch(pr, uuid, clients);
+  for (size_t i = 0; i < count; ++i) {
+    fio_tls_accept(clients[i], pr->tls, pr->udata);
   }
 }
 
@@ -4584,7 +7950,17 @@ intptr_t fio_listen FIO_IGNORE_MACRO(struct fio_listen_args args) {
       goto error;
     }
   }
-  const intptr_t uuid = fio_socket(args.address, args.port, 1);
+#ifndef SO_REUSEPORT
+  args.reuse_port = 0;
+#endif
+  /* Unix sockets (and port "0") never share a port */
+  if (!args.port || fio_is_running())
+    args.reuse_port = 0;
+  const intptr_t uuid = fio_socket_internal(
+      args.address, args.port,
+      (args.reuse_port
+           ? (FIO_SOCKET_SERVER | FIO_SOCKET_REUSE_PORT | FIO_SOCKET_BIND_ONLY)
+           : FIO_SOCKET_SERVER));
   if (uuid == -1)
     goto error;
 
@@ -4611,6 +7987,8 @@ intptr_t fio_listen FIO_IGNORE_MACRO(struct fio_listen_args args) {
       .on_start = args.on_start,
       .on_finish = args.on_finish,
       .tls = args.tls,
+      .reuse_port = args.reuse_port,
+      .on_data_budget = args.on_data_budget,
       .addr_len = addr_len,
       .port_len = port_len,
       .addr = (char *)(pr + 1),
@@ -5194,11 +8572,11 @@ static int fio_channel_cmp(channel_s *ch1, channel_s *ch2) {
 
 struct fio_collection_s {
   fio_ch_set_s channels;
-  fio_lock_i lock;
+  fio_mutex_i lock;
 };
 
 #define COLLECTION_INIT                                                        \
-  { .channels = FIO_SET_INIT, .lock = FIO_LOCK_INIT }
+  { .channels = FIO_SET_INIT, .lock = FIO_MUTEX_INIT }
 
 static struct {
   fio_collection_s filters;
@@ -5206,18 +8584,18 @@ static struct {
   fio_collection_s patterns;
   struct {
     fio_engine_set_s set;
-    fio_lock_i lock;
+    fio_mutex_i lock;
   } engines;
   struct {
     fio_meta_ary_s ary;
-    fio_lock_i lock;
+    fio_mutex_i lock;
   } meta;
 } fio_postoffice = {
     .filters = COLLECTION_INIT,
     .pubsub = COLLECTION_INIT,
     .patterns = COLLECTION_INIT,
-    .engines.lock = FIO_LOCK_INIT,
-    .meta.lock = FIO_LOCK_INIT,
+    .engines.lock = FIO_MUTEX_INIT,
+    .meta.lock = FIO_MUTEX_INIT,
 };
 
 /** used to contain the message before it's passed to the handler */
@@ -5252,9 +8630,9 @@ static fio_meta_ary_s fio_postoffice_meta_copy_new(void) {
   if (!fio_meta_ary_count(&fio_postoffice.meta.ary)) {
     return t;
   }
-  fio_lock(&fio_postoffice.meta.lock);
+  fio_mutex_lock(&fio_postoffice.meta.lock);
   fio_meta_ary_concat(&t, &fio_postoffice.meta.ary);
-  fio_unlock(&fio_postoffice.meta.lock);
+  fio_mutex_unlock(&fio_postoffice.meta.lock);
   return t;
 }
 
@@ -5375,11 +8753,11 @@ static void fio_pubsub_on_channel_destroy(channel_s *ch);
 static inline channel_s *fio_filter_dup_lock_internal(channel_s *ch,
                                                       uint64_t hashed,
                                                       fio_collection_s *c) {
-  fio_lock(&c->lock);
+  fio_mutex_lock(&c->lock);
   ch = fio_ch_set_insert(&c->channels, hashed, ch);
   fio_channel_dup(ch);
   fio_lock(&ch->lock);
-  fio_unlock(&c->lock);
+  fio_mutex_unlock(&c->lock);
   return ch;
 }
 
@@ -5496,13 +8874,13 @@ void fio_unsubscribe(subscription_s *s) {
     uint64_t hashed = FIO_HASH_FN(
         ch->name, ch->name_len, &fio_postoffice.pubsub, &fio_postoffice.pubsub);
     /* lock collection */
-    fio_lock(&c->lock);
+    fio_mutex_lock(&c->lock);
     /* test again within lock */
     if (fio_ls_embd_is_empty(&ch->subscriptions)) {
       fio_ch_set_remove(&c->channels, hashed, ch, NULL);
       removed = (c != &fio_postoffice.filters);
     }
-    fio_unlock(&c->lock);
+    fio_mutex_unlock(&c->lock);
   }
   fio_unlock(&ch->lock);
   if (removed) {
@@ -5537,7 +8915,7 @@ static inline void fio_cluster_inform_root_about_channel(channel_s *ch,
 
 /* runs in lock(!) let'm all know */
 static void fio_pubsub_on_channel_create(channel_s *ch) {
-  fio_lock(&fio_postoffice.engines.lock);
+  fio_mutex_lock(&fio_postoffice.engines.lock);
   FIO_SET_FOR_LOOP(&fio_postoffice.engines.set, pos) {
     if (!pos->hash)
       continue;
@@ -5545,13 +8923,13 @@ static void fio_pubsub_on_channel_create(channel_s *ch) {
                         (fio_str_info_s){.data = ch->name, .len = ch->name_len},
                         ch->match);
   }
-  fio_unlock(&fio_postoffice.engines.lock);
+  fio_mutex_unlock(&fio_postoffice.engines.lock);
   fio_cluster_inform_root_about_channel(ch, 1);
 }
 
 /* runs in lock(!) let'm all know */
 static void fio_pubsub_on_channel_destroy(channel_s *ch) {
-  fio_lock(&fio_postoffice.engines.lock);
+  fio_mutex_lock(&fio_postoffice.engines.lock);
   FIO_SET_FOR_LOOP(&fio_postoffice.engines.set, pos) {
     if (!pos->hash)
       continue;
@@ -5559,7 +8937,7 @@ static void fio_pubsub_on_channel_destroy(channel_s *ch) {
         pos->obj, (fio_str_info_s){.data = ch->name, .len = ch->name_len},
         ch->match);
   }
-  fio_unlock(&fio_postoffice.engines.lock);
+  fio_mutex_unlock(&fio_postoffice.engines.lock);
   fio_cluster_inform_root_about_channel(ch, 0);
 }
 
@@ -5574,27 +8952,27 @@ static void fio_pubsub_on_channel_destroy(channel_s *ch) {
  * exclusive subscription process.
  */
 void fio_pubsub_attach(fio_pubsub_engine_s *engine) {
-  fio_lock(&fio_postoffice.engines.lock);
+  fio_mutex_lock(&fio_postoffice.engines.lock);
   fio_engine_set_insert(&fio_postoffice.engines.set, (uintptr_t)engine, engine);
-  fio_unlock(&fio_postoffice.engines.lock);
+  fio_mutex_unlock(&fio_postoffice.engines.lock);
   fio_pubsub_reattach(engine);
 }
 
 /** Detaches an engine, so it could be safely destroyed. */
 void fio_pubsub_detach(fio_pubsub_engine_s *engine) {
-  fio_lock(&fio_postoffice.engines.lock);
+  fio_mutex_lock(&fio_postoffice.engines.lock);
   fio_engine_set_remove(&fio_postoffice.engines.set, (uintptr_t)engine, engine,
                         NULL);
-  fio_unlock(&fio_postoffice.engines.lock);
+  fio_mutex_unlock(&fio_postoffice.engines.lock);
 }
 
 /** Returns true (1) if the engine is attached to the system. */
 int fio_pubsub_is_attached(fio_pubsub_engine_s *engine) {
   fio_pubsub_engine_s *addr;
-  fio_lock(&fio_postoffice.engines.lock);
+  fio_mutex_lock(&fio_postoffice.engines.lock);
   addr = fio_engine_set_find(&fio_postoffice.engines.set, (uintptr_t)engine,
                              engine);
-  fio_unlock(&fio_postoffice.engines.lock);
+  fio_mutex_unlock(&fio_postoffice.engines.lock);
   return addr != NULL;
 }
 
@@ -5614,7 +8992,7 @@ int fio_pubsub_is_attached(fio_pubsub_engine_s *engine) {
  * exclusive subscription process.
  */
 void fio_pubsub_reattach(fio_pubsub_engine_s *eng) {
-  fio_lock(&fio_postoffice.pubsub.lock);
+  fio_mutex_lock(&fio_postoffice.pubsub.lock);
   FIO_SET_FOR_LOOP(&fio_postoffice.pubsub.channels, pos) {
     if (!pos->hash)
       continue;
@@ -5623,8 +9001,8 @@ void fio_pubsub_reattach(fio_pubsub_engine_s *eng) {
         (fio_str_info_s){.data = pos->obj->name, .len = pos->obj->name_len},
         NULL);
   }
-  fio_unlock(&fio_postoffice.pubsub.lock);
-  fio_lock(&fio_postoffice.patterns.lock);
+  fio_mutex_unlock(&fio_postoffice.pubsub.lock);
+  fio_mutex_lock(&fio_postoffice.patterns.lock);
   FIO_SET_FOR_LOOP(&fio_postoffice.patterns.channels, pos) {
     if (!pos->hash)
       continue;
@@ -5633,7 +9011,7 @@ void fio_pubsub_reattach(fio_pubsub_engine_s *eng) {
         (fio_str_info_s){.data = pos->obj->name, .len = pos->obj->name_len},
         pos->obj->match);
   }
-  fio_unlock(&fio_postoffice.patterns.lock);
+  fio_mutex_unlock(&fio_postoffice.patterns.lock);
 }
 
 /* *****************************************************************************
@@ -5644,11 +9022,11 @@ void fio_message_metadata_callback_set(fio_msg_metadata_fn callback,
                                        int enable) {
   if (!callback)
     return;
-  fio_lock(&fio_postoffice.meta.lock);
+  fio_mutex_lock(&fio_postoffice.meta.lock);
   fio_meta_ary_remove2(&fio_postoffice.meta.ary, callback, NULL);
   if (enable)
     fio_meta_ary_push(&fio_postoffice.meta.ary, callback);
-  fio_unlock(&fio_postoffice.meta.lock);
+  fio_mutex_unlock(&fio_postoffice.meta.lock);
 }
 
 /** Finds the message's metadata by it's type ID. */
@@ -5671,14 +9049,14 @@ void *fio_message_metadata(fio_msg_s *msg, intptr_t type_id) {
 static channel_s *fio_channel_find_dup_internal(channel_s *ch_tmp,
                                                 uint64_t hashed,
                                                 fio_collection_s *c) {
-  fio_lock(&c->lock);
+  fio_mutex_lock(&c->lock);
   channel_s *ch = fio_ch_set_find(&c->channels, hashed, ch_tmp);
   if (!ch) {
-    fio_unlock(&c->lock);
+    fio_mutex_unlock(&c->lock);
     return NULL;
   }
   fio_channel_dup(ch);
-  fio_unlock(&c->lock);
+  fio_mutex_unlock(&c->lock);
   return ch;
 }
 
@@ -5729,7 +9107,9 @@ static void fio_perform_subscription_callback(void *s_, void *msg_) {
   };
   if (s->on_message) {
     /* the on_message callback is removed when a subscription is canceled. */
+    const uint64_t start = fio_histogram_now();
     s->on_message(&m.msg);
+    fio_histogram_add(FIO_HISTOGRAM_PUBSUB, fio_histogram_now() - start);
   }
   fio_unlock(&s->lock);
   if (m.marker) {
@@ -5788,7 +9168,7 @@ static void fio_publish2process(fio_msg_internal_s *m) {
   }
   if (m->filter == 0) {
     /* pattern matching match */
-    fio_lock(&fio_postoffice.patterns.lock);
+    fio_mutex_lock(&fio_postoffice.patterns.lock);
     FIO_SET_FOR_LOOP(&fio_postoffice.patterns.channels, p) {
       if (!p->hash) {
         continue;
@@ -5802,7 +9182,7 @@ static void fio_publish2process(fio_msg_internal_s *m) {
                               fio_msg_internal_dup(m));
       }
     }
-    fio_unlock(&fio_postoffice.patterns.lock);
+    fio_mutex_unlock(&fio_postoffice.patterns.lock);
   }
 finish:
   fio_msg_internal_free(m);
@@ -6288,22 +9668,22 @@ static void fio_cluster_on_connect(intptr_t uuid, void *udata) {
   cluster_data.uuid = uuid;
 
   /* inform root about all existing channels */
-  fio_lock(&fio_postoffice.pubsub.lock);
+  fio_mutex_lock(&fio_postoffice.pubsub.lock);
   FIO_SET_FOR_LOOP(&fio_postoffice.pubsub.channels, pos) {
     if (!pos->hash) {
       continue;
     }
     fio_cluster_inform_root_about_channel(pos->obj, 1);
   }
-  fio_unlock(&fio_postoffice.pubsub.lock);
-  fio_lock(&fio_postoffice.patterns.lock);
+  fio_mutex_unlock(&fio_postoffice.pubsub.lock);
+  fio_mutex_lock(&fio_postoffice.patterns.lock);
   FIO_SET_FOR_LOOP(&fio_postoffice.patterns.channels, pos) {
     if (!pos->hash) {
       continue;
     }
     fio_cluster_inform_root_about_channel(pos->obj, 1);
   }
-  fio_unlock(&fio_postoffice.patterns.lock);
+  fio_mutex_unlock(&fio_postoffice.patterns.lock);
 
   fio_attach(uuid, fio_cluster_protocol_alloc(uuid, fio_cluster_client_handler,
                                               fio_cluster_client_sender));
@@ -6463,11 +9843,11 @@ Cluster forking handler
 ***************************************************************************** */
 
 static void fio_pubsub_on_fork(void) {
-  fio_postoffice.filters.lock = FIO_LOCK_INIT;
-  fio_postoffice.pubsub.lock = FIO_LOCK_INIT;
-  fio_postoffice.patterns.lock = FIO_LOCK_INIT;
-  fio_postoffice.engines.lock = FIO_LOCK_INIT;
-  fio_postoffice.meta.lock = FIO_LOCK_INIT;
+  fio_postoffice.filters.lock = FIO_MUTEX_INIT;
+  fio_postoffice.pubsub.lock = FIO_MUTEX_INIT;
+  fio_postoffice.patterns.lock = FIO_MUTEX_INIT;
+  fio_postoffice.engines.lock = FIO_MUTEX_INIT;
+  fio_postoffice.meta.lock = FIO_MUTEX_INIT;
   cluster_data.lock = FIO_LOCK_INIT;
   cluster_data.uuid = 0;
   FIO_SET_FOR_LOOP(&fio_postoffice.filters.channels, pos) {
@@ -6800,6 +10180,7 @@ void *fio_mmap(size_t size) { return calloc(size, 1); }
 void fio_malloc_after_fork(void) {}
 void fio_mem_destroy(void) {}
 void fio_mem_init(void) {}
+FIO_FUNC void fio_mem_arena_bind(size_t cpu) { (void)cpu; }
 
 #else
 
@@ -7004,11 +10385,11 @@ static struct {
   fio_ls_embd_s available; /* free list for memory blocks */
   // intptr_t count;          /* free list counter */
   size_t cores;    /* the number of detected CPU cores*/
-  fio_lock_i lock; /* a global lock */
-  uint8_t forked;  /* a forked collection indicator. */
+  fio_mutex_i lock; /* a global lock */
+  uint8_t forked;   /* a forked collection indicator. */
 } memory = {
     .cores = 1,
-    .lock = FIO_LOCK_INIT,
+    .lock = FIO_MUTEX_INIT,
     .available = FIO_LS_INIT(memory.available),
 };
 
@@ -7078,13 +10459,19 @@ static void arena_enter(void) { arena_last_used = arena_lock(arena_last_used); }
 
 static inline void arena_exit(void) { fio_unlock(&arena_last_used->lock); }
 
+/* prefers the arena matching the CPU core (for threads pinned to a core) */
+FIO_FUNC void fio_mem_arena_bind(size_t cpu) {
+  if (arenas)
+    arena_last_used = arenas + (cpu % memory.cores);
+}
+
 /** Clears any memory locks, in case of a system call to `fork`. */
 void fio_malloc_after_fork(void) {
   arena_last_used = NULL;
   if (!arenas) {
     return;
   }
-  memory.lock = FIO_LOCK_INIT;
+  memory.lock = FIO_MUTEX_INIT;
   memory.forked = 1;
   for (size_t i = 0; i < memory.cores; ++i) {
     arenas[i].lock = FIO_LOCK_INIT;
@@ -7122,16 +10509,16 @@ static inline void block_free(block_s *blk) {
     return;
 
   memset(blk + 1, 0, (FIO_MEMORY_BLOCK_SIZE - sizeof(*blk)));
-  fio_lock(&memory.lock);
+  fio_mutex_lock(&memory.lock);
   fio_ls_embd_push(&memory.available, &((block_node_s *)blk)->node);
 
   blk = blk->parent;
 
   if (fio_atomic_sub(&blk->root_ref, 1)) {
-    fio_unlock(&memory.lock);
+    fio_mutex_unlock(&memory.lock);
     return;
   }
-  // fio_unlock(&memory.lock);
+  // fio_mutex_unlock(&memory.lock);
   // return;
 
   /* remove all of the root block's children (slices) from the memory pool */
@@ -7141,7 +10528,7 @@ static inline void block_free(block_s *blk) {
     fio_ls_embd_remove(&pos->node);
   }
 
-  fio_unlock(&memory.lock);
+  fio_mutex_unlock(&memory.lock);
   sys_free(blk, FIO_MEMORY_BLOCK_SIZE * FIO_MEMORY_BLOCKS_PER_ALLOCATION);
   FIO_LOG_DEBUG("memory allocator returned %p to the system", (void *)blk);
   FIO_MEMORY_ON_BLOCK_FREE();
@@ -7151,20 +10538,20 @@ static inline void block_free(block_s *blk) {
 static inline block_s *block_new(void) {
   block_s *blk = NULL;
 
-  fio_lock(&memory.lock);
+  fio_mutex_lock(&memory.lock);
   blk = (block_s *)fio_ls_embd_pop(&memory.available);
   if (blk) {
     blk = (block_s *)FIO_LS_EMBD_OBJ(block_node_s, node, blk);
     FIO_ASSERT(((uintptr_t)blk & FIO_MEMORY_BLOCK_MASK) == 0,
                "Memory allocator error! double `fio_free`?\n");
     block_init(blk); /* must be performed within lock */
-    fio_unlock(&memory.lock);
+    fio_mutex_unlock(&memory.lock);
     return blk;
   }
   /* collect memory from the system */
   blk = sys_alloc(FIO_MEMORY_BLOCK_SIZE * FIO_MEMORY_BLOCKS_PER_ALLOCATION, 0);
   if (!blk) {
-    fio_unlock(&memory.lock);
+    fio_mutex_unlock(&memory.lock);
     return NULL;
   }
   FIO_LOG_DEBUG("memory allocator allocated %p from the system", (void *)blk);
@@ -7177,7 +10564,7 @@ static inline block_s *block_new(void) {
     block_init_root((block_s *)tmp, blk);
     fio_ls_embd_push(&memory.available, &tmp->node);
   }
-  fio_unlock(&memory.lock);
+  fio_mutex_unlock(&memory.lock);
   /* return the root block (which isn't in the memory pool). */
   return blk;
 }
@@ -9373,31 +12760,90 @@ Testing fio_timers
 
 FIO_FUNC void fio_timer_test_task(void *arg) { ++(((size_t *)arg)[0]); }
 
+FIO_FUNC void fio_timer_test_wheel(void) {
+  const size_t total = 1000000;
+  const size_t max_interval = 100000; /* ms */
+  size_t performed = 0;
+  size_t finished = 0;
+  fio_timer_s **timers = malloc(sizeof(*timers) * total);
+  FIO_ASSERT_ALLOC(timers);
+  fprintf(stderr, "* Testing timing wheel with %zu timers.\n", total);
+  clock_t start = clock();
+  for (size_t i = 0; i < total; ++i) {
+    timers[i] = fio_run_every((i % max_interval) + 1, 1, fio_timer_test_task,
+                              &performed, NULL);
+    FIO_ASSERT(timers[i], "Timer creation failure (%zu).", i);
+  }
+  clock_t end = clock();
+  fprintf(stderr, "\t- added in %zu us.\n",
+          (size_t)((end - start) * 1000000 / CLOCKS_PER_SEC));
+  FIO_ASSERT(fio_timer_count_unsafe() == total,
+             "Timing wheel count error (%zu != %zu)", fio_timer_count_unsafe(),
+             total);
+  start = clock();
+  for (size_t i = 0; i < total; i += 2) {
+    FIO_ASSERT(!fio_timer_cancel(timers[i]), "Timer cancellation failure.");
+    ++finished;
+  }
+  end = clock();
+  fprintf(stderr, "\t- canceled half in %zu us.\n",
+          (size_t)((end - start) * 1000000 / CLOCKS_PER_SEC));
+  FIO_ASSERT(fio_timer_count_unsafe() == total - finished,
+             "Timing wheel count error after cancellation (%zu != %zu)",
+             fio_timer_count_unsafe(), total - finished);
+  start = clock();
+  for (size_t ms = 0; ms <= max_interval; ms += 250) {
+    /* half the timers due by now were canceled (allow 1 second of drift) */
+    const size_t expected = ms * (total / max_interval) / 2;
+    const size_t drift = (total / max_interval) * 1000 / 2;
+    fio_data->last_cycle.tv_nsec += 250000000L;
+    if (fio_data->last_cycle.tv_nsec >= 1000000000L) {
+      fio_data->last_cycle.tv_nsec -= 1000000000L;
+      fio_data->last_cycle.tv_sec += 1;
+    }
+    fio_timer_schedule();
+    fio_defer_perform();
+    FIO_ASSERT(performed + drift >= expected && performed <= expected + drift,
+               "Timing wheel expiry error (%zu != ~%zu at %zums)", performed,
+               expected, ms);
+  }
+  fio_data->last_cycle.tv_sec += 1;
+  fio_timer_schedule();
+  fio_defer_perform();
+  end = clock();
+  fprintf(stderr, "\t- performed %zu in %zu us.\n", performed,
+          (size_t)((end - start) * 1000000 / CLOCKS_PER_SEC));
+  FIO_ASSERT(performed == total - finished,
+             "Timing wheel expiry error (%zu != %zu)", performed,
+             total - finished);
+  FIO_ASSERT(!fio_timer_count_unsafe(), "Timing wheel should be empty.");
+  free(timers);
+}
+
 FIO_FUNC void fio_timer_test(void) {
   fprintf(stderr, "=== Testing facil.io timer system\n");
   size_t result = 0;
   const size_t total = 5;
   fio_data->active = 1;
-  FIO_ASSERT(fio_timers.next, "Timers not initialized!");
-  FIO_ASSERT(fio_run_every(0, 0, fio_timer_test_task, NULL, NULL) == -1,
+  FIO_ASSERT(fio_run_every(0, 0, fio_timer_test_task, NULL, NULL) == NULL,
              "Timers without an interval should be an error.");
-  FIO_ASSERT(fio_run_every(1000, 0, NULL, NULL, NULL) == -1,
+  FIO_ASSERT(fio_run_every(1000, 0, NULL, NULL, NULL) == NULL,
              "Timers without a task should be an error.");
   FIO_ASSERT(fio_run_every(900, total, fio_timer_test_task, &result,
-                           fio_timer_test_task) == 0,
+                           fio_timer_test_task),
              "Timer creation failure.");
-  FIO_ASSERT(fio_ls_embd_any(&fio_timers),
-             "Timer scheduling failure - no timer in list.");
+  FIO_ASSERT(fio_timer_count_unsafe() == 1,
+             "Timer scheduling failure - no timer in wheel.");
   FIO_ASSERT(fio_timer_calc_first_interval() >= 898 &&
                  fio_timer_calc_first_interval() <= 902,
              "next timer calculation error %zu",
              fio_timer_calc_first_interval());
 
-  fio_ls_embd_s *first = fio_timers.next;
   FIO_ASSERT(fio_run_every(10000, total, fio_timer_test_task, &result,
-                           fio_timer_test_task) == 0,
+                           fio_timer_test_task),
              "Timer creation failure (second timer).");
-  FIO_ASSERT(fio_timers.next == first, "Timer Ordering error!");
+  FIO_ASSERT(fio_timer_count_unsafe() == 2,
+             "Timer scheduling failure - second timer not in wheel.");
 
   FIO_ASSERT(fio_timer_calc_first_interval() >= 898 &&
                  fio_timer_calc_first_interval() <= 902,
@@ -9418,8 +12864,8 @@ FIO_FUNC void fio_timer_test(void) {
                 (i == total - 1 && result == total + 1)),
                "Timer running and rescheduling error (%zu != %zu)\n", result,
                i + 1);
-    FIO_ASSERT(fio_timers.next == first || i == total - 1,
-               "Timer Ordering error on cycle %zu!", i);
+    FIO_ASSERT(fio_timer_count_unsafe() == 2 - (i == total - 1),
+               "Timer rescheduling error on cycle %zu!", i);
   }
 
   fio_data->last_cycle.tv_sec += 10;
@@ -9427,6 +12873,66 @@ FIO_FUNC void fio_timer_test(void) {
   fio_defer_perform();
   FIO_ASSERT(result == total + 2, "Timer # 2 error (%zu != %zu)\n", result,
              total + 2);
+
+  {
+    /* cancellation */
+    size_t canceled = 0;
+    fio_timer_clear_all();
+    fio_timer_s *timer = fio_run_every(100, 0, fio_timer_test_task, &result,
+                                       fio_timer_test_task);
+    FIO_ASSERT(timer, "Timer creation failure (cancellation).");
+    result = 0;
+    fio_data->last_cycle.tv_sec += 1;
+    fio_timer_schedule();
+    fio_defer_perform();
+    FIO_ASSERT(result == 1, "Timer error before cancellation (%zu != 1)",
+               result);
+    FIO_ASSERT(!fio_timer_cancel(timer), "Timer cancellation failure.");
+    FIO_ASSERT(result == 2, "Timer cancellation should call on_finish.");
+    FIO_ASSERT(!fio_timer_count_unsafe(), "Canceled timer remains in wheel.");
+    /* cancel while scheduled */
+    timer = fio_run_every(100, 0, fio_timer_test_task, &canceled,
+                          fio_timer_test_task);
+    fio_data->last_cycle.tv_sec += 1;
+    fio_timer_schedule();
+    FIO_ASSERT(!fio_timer_cancel(timer),
+               "Timer cancellation failure (scheduled).");
+    FIO_ASSERT(fio_timer_cancel(timer) == -1,
+               "Timer cancellation should fail when already canceled.");
+    fio_defer_perform();
+    FIO_ASSERT(canceled == 1,
+               "Scheduled timer should finish (not run) once canceled (%zu)",
+               canceled);
+    FIO_ASSERT(!fio_timer_count_unsafe(), "Canceled timer rescheduled.");
+  }
+
+  fio_timer_test_wheel();
+
+  if (sizeof(size_t) > 4) {
+    /* intervals beyond the wheel's span (~49.7 days) */
+    const uint64_t interval = ((uint64_t)1 << 33) + 1000; /* ~99.4 days */
+    const uint64_t step = (uint64_t)1 << 24; /* a highest level slot (ms) */
+    size_t long_result = 0;
+    fio_timer_clear_all();
+    FIO_ASSERT(fio_run_every((size_t)interval, 1, fio_timer_test_task,
+                             &long_result, NULL),
+               "Timer creation failure (long interval).");
+    for (uint64_t ms = step; ms + step < interval; ms += step) {
+      fio_data->last_cycle.tv_sec += step / 1000;
+      fio_timer_schedule();
+      fio_defer_perform();
+      FIO_ASSERT(!long_result && fio_timer_count_unsafe() == 1,
+                 "Long interval timer error at %zums (%zu performed)",
+                 (size_t)ms, long_result);
+    }
+    fio_data->last_cycle.tv_sec += (step * 2) / 1000;
+    fio_timer_schedule();
+    fio_defer_perform();
+    FIO_ASSERT(long_result == 1 && !fio_timer_count_unsafe(),
+               "Long interval timer should have been performed (%zu)",
+               long_result);
+  }
+
   fio_data->active = 0;
   fio_timer_clear_all();
   fio_defer_clear_tasks();
@@ -9437,6 +12943,193 @@ FIO_FUNC void fio_timer_test(void) {
 Testing listening socket
 ***************************************************************************** */
 
+FIO_FUNC ssize_t fio_socket_test_blocked_write(intptr_t uuid, void *udata,
+                                               const void *buf, size_t count) {
+  errno = EWOULDBLOCK;
+  return -1;
+  (void)uuid;
+  (void)udata;
+  (void)buf;
+  (void)count;
+}
+
+static size_t fio_socket_test_dealloc_count;
+FIO_FUNC void fio_socket_test_dealloc(void *buf) {
+  ++fio_socket_test_dealloc_count;
+  fio_free(buf);
+}
+
+static size_t fio_socket_test_congested_count;
+static size_t fio_socket_test_drained_count;
+FIO_FUNC void fio_socket_test_on_congested(intptr_t uuid, fio_protocol_s *pr) {
+  ++fio_socket_test_congested_count;
+  (void)uuid;
+  (void)pr;
+}
+FIO_FUNC void fio_socket_test_on_drained(intptr_t uuid, fio_protocol_s *pr) {
+  ++fio_socket_test_drained_count;
+  (void)uuid;
+  (void)pr;
+}
+
+FIO_FUNC void fio_socket_test_watermarks(void) {
+  static fio_protocol_s protocol = {
+      .on_congested = fio_socket_test_on_congested,
+      .on_drained = fio_socket_test_on_drained,
+      .watermark_high = 1024,
+      .watermark_low = 256,
+  };
+  static fio_rw_hook_s blocked_hooks = {.write = fio_socket_test_blocked_write};
+  char buf[4096];
+  size_t r = 0;
+  int s[2];
+  FIO_ASSERT(!socketpair(AF_UNIX, SOCK_STREAM, 0, s),
+             "socketpair failed (watermarks test)");
+  fio_set_non_block(s[0]);
+  fio_set_non_block(s[1]);
+  const intptr_t uuid = fio_fd2uuid(s[1]);
+  fio_socket_test_congested_count = 0;
+  fio_socket_test_drained_count = 0;
+  fio_attach(uuid, &protocol);
+  FIO_ASSERT(uuid_cold(uuid).watermark_high == 1024 &&
+                 uuid_cold(uuid).watermark_low == 256,
+             "fio_attach didn't apply the protocol's watermarks");
+  /* write past the high watermark while writing is blocked */
+  fio_rw_hook_set(uuid, &blocked_hooks, NULL);
+  memset(buf, 'w', sizeof(buf));
+  fio_write(uuid, buf, sizeof(buf));
+  FIO_ASSERT(fio_is_congested(uuid) && fio_pending_bytes(uuid) == sizeof(buf),
+             "connection should be congested (%zu bytes pending)",
+             fio_pending_bytes(uuid));
+  fio_defer_perform();
+  FIO_ASSERT(fio_socket_test_congested_count == 1 &&
+                 !fio_socket_test_drained_count,
+             "on_congested should have been called (once)");
+  /* flush, the queue drains below the low watermark */
+  fio_rw_hook_set(uuid, (fio_rw_hook_s *)&FIO_DEFAULT_RW_HOOKS, NULL);
+  for (size_t i = 0; i < 100 && r < sizeof(buf); ++i) {
+    fio_flush(uuid);
+    ssize_t tmp = read(s[0], buf + r, sizeof(buf) - r);
+    if (tmp > 0)
+      r += tmp;
+    else
+      fio_reschedule_thread();
+  }
+  FIO_ASSERT(r == sizeof(buf), "watermarks test data lost (%zu bytes)", r);
+  fio_defer_perform();
+  FIO_ASSERT(!fio_is_congested(uuid) && !fio_pending_bytes(uuid),
+             "connection should have drained (%zu bytes pending)",
+             fio_pending_bytes(uuid));
+  FIO_ASSERT(fio_socket_test_congested_count == 1 &&
+                 fio_socket_test_drained_count == 1,
+             "on_drained should have been called (once)");
+  fio_force_close(uuid);
+  close(s[0]);
+  fio_defer_perform();
+  fprintf(stderr, "* Outgoing queue watermarks passed.\n");
+}
+
+FIO_FUNC void fio_socket_test_splice_on_close(void *closed) {
+  ++*(size_t *)closed;
+}
+
+/* cycles the reactor, reading from `fd` until `len` bytes (or EOF) arrive */
+FIO_FUNC size_t fio_socket_test_splice_pump(int fd, char *buf, size_t len) {
+  size_t got = 0;
+  for (size_t i = 0; i < 4000 && got < len; ++i) {
+    fio_poll();
+    fio_defer_perform();
+    ssize_t r = read(fd, buf + got, len - got);
+    if (r > 0)
+      got += r;
+    else if (!r || (errno != EAGAIN && errno != EWOULDBLOCK))
+      break;
+  }
+  return got;
+}
+
+FIO_FUNC void fio_socket_test_splice(uint8_t copy) {
+  static fio_rw_hook_s copy_hooks;
+  const size_t len = 1 << 20;
+  size_t closed = 0;
+  size_t filler = 0;
+  int a[2], b[2];
+  char *buf = fio_malloc(len);
+  FIO_ASSERT_ALLOC(buf);
+  FIO_ASSERT(!socketpair(AF_UNIX, SOCK_STREAM, 0, a) &&
+                 !socketpair(AF_UNIX, SOCK_STREAM, 0, b),
+             "socketpair failed (fio_splice test)");
+  for (size_t i = 0; i < 2; ++i) {
+    fio_set_non_block(a[i]);
+    fio_set_non_block(b[i]);
+  }
+  const intptr_t ua = fio_fd2uuid(a[1]);
+  const intptr_t ub = fio_fd2uuid(b[1]);
+  if (copy) {
+    /* any read / write hook forces the copying fallback */
+    copy_hooks = FIO_DEFAULT_RW_HOOKS;
+    fio_rw_hook_set(ub, &copy_hooks, NULL);
+  }
+  FIO_ASSERT(!fio_splice(ua, ub, .on_close = fio_socket_test_splice_on_close,
+                         .udata = &closed),
+             "fio_splice failed");
+  FIO_ASSERT((((fio_splice_side_s *)uuid_data(ua).protocol)->pipe[0] == -1) ==
+                 (copy || !FIO_SPLICE),
+             "fio_splice should only copy the data when hooks are set");
+  /* both directions */
+  FIO_ASSERT(write(a[0], "ping", 4) == 4 && write(b[0], "pong", 4) == 4,
+             "fio_splice test write failed");
+  FIO_ASSERT(fio_socket_test_splice_pump(b[0], buf, 4) == 4 &&
+                 !memcmp(buf, "ping", 4),
+             "fio_splice (%s) didn't forward data (a => b)",
+             copy ? "copy" : "pipe");
+  FIO_ASSERT(fio_socket_test_splice_pump(a[0], buf, 4) == 4 &&
+                 !memcmp(buf, "pong", 4),
+             "fio_splice (%s) didn't forward data (b => a)",
+             copy ? "copy" : "pipe");
+  /* a blocked (and congested) peer, data waits until the peer is writable */
+  fio_watermarks_set(ub, 1024, 256);
+  memset(buf, 'f', len);
+  for (ssize_t r = 1; r > 0 && filler < len; filler += (r > 0 ? r : 0))
+    r = write(b[1], buf, len - filler);
+  memset(buf, 'd', 8192);
+  FIO_ASSERT(write(a[0], buf, 8192) == 8192, "fio_splice test write failed");
+  for (size_t i = 0; i < 16; ++i) {
+    fio_poll();
+    fio_defer_perform();
+  }
+  FIO_ASSERT(fio_socket_test_splice_pump(b[0], buf, filler + 8192) ==
+                     filler + 8192 &&
+                 buf[filler] == 'd' && buf[filler + 8191] == 'd',
+             "fio_splice (%s) stalled while the peer was blocked",
+             copy ? "copy" : "pipe");
+  /* data still on it's way when a connection closes is delivered */
+  filler = 0;
+  memset(buf, 'f', len);
+  for (ssize_t r = 1; r > 0 && filler < len; filler += (r > 0 ? r : 0))
+    r = write(b[1], buf, len - filler);
+  FIO_ASSERT(write(a[0], "tail", 4) == 4, "fio_splice test write failed");
+  for (size_t i = 0; i < 16; ++i) {
+    fio_poll();
+    fio_defer_perform();
+  }
+  close(a[0]);
+  FIO_ASSERT(fio_socket_test_splice_pump(b[0], buf, len) == filler + 4 &&
+                 !memcmp(buf + filler, "tail", 4),
+             "fio_splice (%s) lost data when a connection closed",
+             copy ? "copy" : "pipe");
+  for (size_t i = 0; i < 100 && !closed; ++i) {
+    fio_poll();
+    fio_defer_perform();
+  }
+  FIO_ASSERT(closed == 1 && !uuid_is_valid(ua) && !uuid_is_valid(ub),
+             "fio_splice (%s) tunnel wasn't closed (%zu)",
+             copy ? "copy" : "pipe", closed);
+  close(b[0]);
+  fio_free(buf);
+  fprintf(stderr, "* fio_splice (%s) cycle passed.\n", copy ? "copy" : "pipe");
+}
+
 FIO_FUNC void fio_socket_test(void) {
   /* initialize unix socket name */
   fio_str_s sock_name = FIO_STR_INIT;
@@ -9528,9 +13221,89 @@ FIO_FUNC void fio_socket_test(void) {
   FIO_ASSERT(client2 != -1,
              "Failed to accept TCP/IP socket connection on port 8765");
   fprintf(stderr, "* TCP/IP client2 addr %s\n", fio_peer_addr(client2).data);
+  {
+    /* queue a few packets while writing is blocked, then test gathering */
+    fio_rw_hook_s blocked_hooks = {.write = fio_socket_test_blocked_write};
+    char tmp_buf[32];
+    ssize_t r = 0;
+    fio_rw_hook_set(client1, &blocked_hooks, NULL);
+    fio_write(client1, "He", 2);
+    FIO_ASSERT(uuid_data(client1).packet &&
+                   uuid_data(client1).packet->dealloc ==
+                       fio_packet_exact_dealloc,
+               "a write to an empty queue shouldn't reserve coalescing room");
+    fio_write(client1, "l", 1);
+    fio_write(client1, "lo ", 3);
+    fio_write2(client1, .data.buffer = "World", .length = 5,
+               .after.dealloc = FIO_DEALLOC_NOOP);
+    FIO_ASSERT(fio_pending(client1) == 3,
+               "small fio_write calls should have been coalesced (%zu)",
+               fio_pending(client1));
+    fio_rw_hook_set(client1, (fio_rw_hook_s *)&FIO_DEFAULT_RW_HOOKS, NULL);
+    fio_flush(client1);
+    FIO_ASSERT(!fio_pending(client1),
+               "fio_flush should have gathered all packets (%zu left)",
+               fio_pending(client1));
+    for (size_t i = 0; i < 100 && r < 11; ++i) {
+      ssize_t tmp = fio_read(client2, tmp_buf + r, 32 - r);
+      if (tmp > 0)
+        r += tmp;
+      else
+        fio_reschedule_thread();
+    }
+    FIO_ASSERT(r == 11 && !memcmp("Hello World", tmp_buf, 11),
+               "Vectored flush Read/Write cycle error (%zd: %.*s)", r, (int)r,
+               tmp_buf);
+    fprintf(stderr, "* Vectored flush Read/Write cycle passed.\n");
+  }
+#if FIO_ZEROCOPY
+  {
+    /* zero-copy buffers are held until the kernel reports a completion */
+    const size_t len = 1 << 16;
+    char *buf = fio_malloc(len);
+    char *tmp_buf = fio_malloc(len);
+    size_t r = 0;
+    FIO_ASSERT_ALLOC(buf && tmp_buf);
+    memset(buf, 'z', len);
+    fio_socket_test_dealloc_count = 0;
+    FIO_ASSERT(!fio_zerocopy_set(client1, len),
+               "fio_zerocopy_set failed for TCP/IP socket");
+    fio_write2(client1, .data.buffer = buf, .length = len,
+               .after.dealloc = fio_socket_test_dealloc);
+    for (size_t i = 0; i < 1000 && r < len; ++i) {
+      ssize_t tmp = fio_read(client2, tmp_buf + r, len - r);
+      if (tmp > 0)
+        r += tmp;
+      else
+        fio_reschedule_thread();
+      fio_flush(client1);
+    }
+    FIO_ASSERT(r == len && !memcmp(buf, tmp_buf, len),
+               "Zero-copy Read/Write cycle error (%zu/%zu)", r, len);
+    for (size_t i = 0; i < 100 && !fio_socket_test_dealloc_count; ++i) {
+      fio_zerocopy_on_error(client1);
+      if (!fio_socket_test_dealloc_count)
+        fio_reschedule_thread();
+    }
+    FIO_ASSERT(fio_socket_test_dealloc_count == 1,
+               "Zero-copy buffer wasn't released after completion.");
+    fprintf(stderr, "* Zero-copy Read/Write cycle passed (%s).\n",
+            (uuid_cold(client1).zerocopy ? "zero-copy"
+                                         : "copied by the kernel"));
+    fio_free(tmp_buf);
+  }
+#endif
   fio_force_close(client1);
   fio_force_close(client2);
   fio_force_close(uuid);
+  fio_socket_test_watermarks();
+  {
+    /* prevent poll from hanging */
+    size_t timer_junk = 0;
+    fio_run_every(1, 0, fio_timer_test_task, &timer_junk, NULL);
+    fio_socket_test_splice(0);
+    fio_socket_test_splice(1);
+  }
   fio_timer_clear_all();
   fio_defer_clear_tasks();
   fprintf(stderr, "* passed.\n");
@@ -9563,6 +13336,16 @@ FIO_FUNC void fio_cycle_test(void) {
   fio_timer_clear_all();
   FIO_ASSERT(end.tv_sec == start.tv_sec + 1 || end.tv_sec == start.tv_sec + 2,
              "facil.io cycling error?");
+  /* test the reactor per thread mode (timers are managed by the first thread) */
+  fio_mark_time();
+  start = fio_last_tick();
+  fio_run_every(1000, 1, fio_cycle_test_task, NULL, NULL);
+  fio_run_every(10000, 1, fio_cycle_test_task2, NULL, NULL);
+  fio_start(.threads = 4, .workers = 1, .reactor_per_thread = 1);
+  end = fio_last_tick();
+  fio_timer_clear_all();
+  FIO_ASSERT(end.tv_sec == start.tv_sec + 1 || end.tv_sec == start.tv_sec + 2,
+             "facil.io cycling error (reactor per thread)?");
   fprintf(stderr, "* passed.\n");
 }
 /* *****************************************************************************
@@ -9586,6 +13369,121 @@ FIO_FUNC void sched_sample_task(void *count, void *i_count) {
   }
 }
 
+/* measures the queue's throughput while many threads push and pop tasks */
+FIO_FUNC void fio_defer_test_contention(void) {
+  const size_t cpu_cores = fio_detect_cpu_cores();
+  const size_t max_threads = (cpu_cores * 2 > 32 ? cpu_cores * 2 : 32);
+  fprintf(stderr, "=== Benchmarking fio_defer contention (%zu shards)\n",
+          (size_t)FIO_DEFER_QUEUE_SHARDS);
+  for (size_t threads = 1; threads <= max_threads; threads <<= 1) {
+    uintptr_t i_count = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t j = 0; j < threads; ++j) {
+      /* every thread becomes a producer (and a consumer) */
+      fio_defer(sched_sample_task, (void *)(FIO_DEFER_TOTAL_COUNT / threads),
+                &i_count);
+    }
+    fio_defer_thread_pool_join(fio_defer_thread_pool_new(threads));
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    FIO_ASSERT(i_count == (FIO_DEFER_TOTAL_COUNT / threads) * threads,
+               "ERROR: defer count invalid (contention test)\n");
+    const size_t us = ((end.tv_sec - start.tv_sec) * 1000000) +
+                      ((end.tv_nsec - start.tv_nsec) / 1000);
+    fprintf(stderr, "\t- %zu threads: %zu tasks in %zu us (%zu tasks/ms)\n",
+            threads, (size_t)i_count, us,
+            (size_t)(us ? (i_count * 1000) / us : i_count));
+  }
+  FIO_ASSERT(fio_defer_count_dealloc == fio_defer_count_alloc,
+             "defer deallocation vs. allocation error, %zu != %zu",
+             fio_defer_count_dealloc, fio_defer_count_alloc);
+}
+
+/* appends a task's index to the performance log */
+FIO_FUNC void fio_defer_test_local_task(void *log_, void *index) {
+  size_t *log = log_;
+  log[++log[0]] = (size_t)index;
+}
+
+FIO_FUNC void fio_defer_test_local(void) {
+  size_t log[FIO_DEFER_LOCAL_BATCH + 8] = {0};
+  fprintf(stderr, "* Testing thread local task queues.\n");
+  fio_defer_local_claim();
+  FIO_ASSERT(fio_defer_local, "couldn't claim a local task queue");
+  /* a shared task, followed by more local tasks than a single batch */
+  fio_defer_push_task(fio_defer_test_local_task, log, (void *)0);
+  for (size_t i = 1; i <= FIO_DEFER_LOCAL_BATCH + 2; ++i)
+    fio_defer(fio_defer_test_local_task, log, (void *)i);
+  FIO_ASSERT(fio_defer_local_any(), "fio_defer should use the local queue");
+  fio_defer_perform();
+  FIO_ASSERT(log[0] == FIO_DEFER_LOCAL_BATCH + 3,
+             "local task count error (%zu)", log[0]);
+  /* local tasks are performed first (FIFO) until a batch is complete */
+  for (size_t i = 1; i <= FIO_DEFER_LOCAL_BATCH; ++i)
+    FIO_ASSERT(log[i] == i, "local task order error (%zu != %zu)", log[i], i);
+  FIO_ASSERT(!log[FIO_DEFER_LOCAL_BATCH + 1],
+             "the shared task should run after a local batch");
+  FIO_ASSERT(log[FIO_DEFER_LOCAL_BATCH + 2] == FIO_DEFER_LOCAL_BATCH + 1 &&
+                 log[FIO_DEFER_LOCAL_BATCH + 3] == FIO_DEFER_LOCAL_BATCH + 2,
+             "local task order error after the shared task");
+  fio_defer_local_release();
+}
+
+/* keeps a pool thread busy until the flag is cleared */
+FIO_FUNC void fio_defer_test_pool_block(void *flag, void *ignr) {
+  while (*(volatile size_t *)flag)
+    fio_throttle_thread(100000);
+  (void)ignr;
+}
+
+FIO_FUNC void *fio_defer_test_pool_supervisor(void *pool) {
+  fio_defer_thread_pool_supervise(pool);
+  return NULL;
+}
+
+/* waits (up to a second) for an adaptive pool to reach `live` threads */
+FIO_FUNC size_t fio_defer_test_pool_wait(fio_defer_thread_pool_s *pool,
+                                         size_t live) {
+  for (size_t i = 0; i < 1000 && *(volatile size_t *)&pool->live != live; ++i) {
+    /* wake suspended threads, so idle threads notice their idle time */
+    fio_thread_broadcast();
+    fio_throttle_thread(1000000);
+  }
+  return *(volatile size_t *)&pool->live;
+}
+
+FIO_FUNC void fio_defer_test_pool(void) {
+  volatile size_t flag = 1;
+  const uint16_t grow_delay = fio_data->grow_delay;
+  fprintf(stderr, "* Testing adaptive thread pools.\n");
+  fio_data->grow_delay = 2;
+  fio_data->active = 1; /* the pool and it's supervisor run until shutdown */
+  fio_defer_thread_pool_s *pool = fio_defer_thread_pool_create(1, 3,
+                                                               fio_defer_cycle);
+  FIO_ASSERT(pool && fio_defer_pool_adaptive == pool,
+             "couldn't create an adaptive thread pool");
+  pool->idle_timeout = 20;
+  void *supervisor = fio_thread_new(fio_defer_test_pool_supervisor, pool);
+  FIO_ASSERT(supervisor, "couldn't spawn the thread pool's supervisor");
+  /* blocked threads and waiting tasks - the pool grows to it's limit */
+  for (size_t i = 0; i < 3; ++i)
+    fio_defer_push_task(fio_defer_test_pool_block, (void *)&flag, NULL);
+  FIO_ASSERT(fio_defer_test_pool_wait(pool, 3) == 3,
+             "the thread pool should have grown to max_threads (%zu)",
+             pool->live);
+  /* idle threads retire after `idle_timeout`, down to the pool's minimum */
+  flag = 0;
+  FIO_ASSERT(fio_defer_test_pool_wait(pool, 1) == 1,
+             "the thread pool should have shrunk back (%zu)", pool->live);
+  FIO_ASSERT(!fio_defer_has_queue(), "thread pool tasks left in the queue");
+  fio_data->active = 0;
+  fio_thread_broadcast();
+  fio_thread_join(supervisor);
+  fio_defer_thread_pool_join(pool);
+  FIO_ASSERT(!fio_defer_pool_adaptive, "adaptive pool wasn't released");
+  fio_data->grow_delay = grow_delay;
+}
+
 FIO_FUNC void fio_defer_test(void) {
   const size_t cpu_cores = fio_detect_cpu_cores();
   FIO_ASSERT(cpu_cores, "couldn't detect CPU cores!");
@@ -9593,6 +13491,12 @@ FIO_FUNC void fio_defer_test(void) {
   clock_t start, end;
   fprintf(stderr, "=== Testing facil.io task scheduling (fio_defer)\n");
   FIO_ASSERT(!fio_defer_has_queue(), "facil.io queue always active.")
+  FIO_ASSERT(sizeof(fio_defer_queue_block_s) <= 4096 &&
+                 sizeof(fio_defer_queue_block_s) +
+                         sizeof(fio_defer_task_s) >
+                     4096,
+             "task queue blocks should fill a page of memory (%zu bytes)",
+             sizeof(fio_defer_queue_block_s));
   i_count = 0;
   start = clock();
   for (size_t i = 0; i < FIO_DEFER_TOTAL_COUNT; i++) {
@@ -9622,6 +13526,9 @@ FIO_FUNC void fio_defer_test(void) {
       fio_defer(sched_sample_task, (void *)per_task, &i_count);
     }
     FIO_ASSERT(fio_defer_has_queue(), "facil.io queue not marked.")
+    FIO_ASSERT(fio_stats().tasks_pending == tasks,
+               "fio_stats task count error (%zu != %zu)",
+               fio_stats().tasks_pending, tasks);
     fio_defer_thread_pool_join(fio_defer_thread_pool_new((i % cpu_cores) + 1));
     end = clock();
     if (FIO_DEFER_TEST_PRINT) {
@@ -9641,9 +13548,21 @@ FIO_FUNC void fio_defer_test(void) {
                "defer deallocation vs. allocation error, %zu != %zu",
                fio_defer_count_dealloc, fio_defer_count_alloc);
   }
-  FIO_ASSERT(task_queue_normal.writer == &task_queue_normal.static_queue,
-             "defer library didn't release dynamic queue (should be static)");
-  fprintf(stderr, "\n* passed.\n");
+  for (size_t i = 0; i < FIO_DEFER_QUEUE_SHARDS; ++i) {
+    FIO_ASSERT(!task_queue_normal[i].writer ||
+                   task_queue_normal[i].writer ==
+                       &task_queue_normal[i].static_queue,
+               "defer library didn't release dynamic queue (should be static)");
+  }
+  FIO_ASSERT(!fio_defer_local_any(),
+             "pool threads didn't perform (or release) their local tasks");
+  FIO_ASSERT(!fio_stats().tasks_pending && !fio_stats().queue_blocks,
+             "fio_stats reports tasks (or queue blocks) after performing all");
+  fprintf(stderr, "\n");
+  fio_defer_test_local();
+  fio_defer_test_pool();
+  fprintf(stderr, "* passed.\n");
+  fio_defer_test_contention();
 }
 
 /* *****************************************************************************
@@ -11003,6 +14922,131 @@ FIO_FUNC void fio_atof_test(void) {
               5708990770823839524233143877797980545530986496.0, 0);
   fprintf(stderr, "\n* passed.\n");
 }
+/* *****************************************************************************
+Latency Histogram Testing
+***************************************************************************** */
+
+FIO_FUNC void fio_histogram_test(void) {
+  fprintf(stderr, "=== Testing latency histograms\n");
+  for (uint64_t i = 0; i < ((uint64_t)1 << 39); i += (i >> 3) + 1) {
+    const size_t index = fio_histogram_index(i);
+    FIO_ASSERT(fio_histogram_bucket_max(index) >= i,
+               "histogram bucket %zu too low for %zu", index, (size_t)i);
+    FIO_ASSERT(!index || fio_histogram_bucket_max(index - 1) < i,
+               "histogram bucket %zu too high for %zu", index, (size_t)i);
+  }
+  FIO_ASSERT(fio_histogram_index((uint64_t)-1) == FIO_HISTOGRAM_BUCKETS - 1,
+             "histogram overflow bucket error");
+  fio_histogram_clear();
+  for (size_t i = 1; i <= 1000; ++i)
+    fio_histogram_add(FIO_HISTOGRAM_TIMER, i * 1000);
+  fio_histogram_s h;
+  fio_histogram(FIO_HISTOGRAM_TIMER, &h);
+  if (FIO_HISTOGRAMS) {
+    FIO_ASSERT(h.count == 1000 && h.max == 1000000, "histogram count error");
+    size_t p50 = fio_histogram_percentile(&h, 50);
+    size_t p99 = fio_histogram_percentile(&h, 99);
+    FIO_ASSERT(p50 >= 500000 && p50 < 640000, "histogram p50 error (%zu)", p50);
+    FIO_ASSERT(p99 >= 990000 && p99 <= 1000000, "histogram p99 error (%zu)",
+               p99);
+  }
+  fio_histogram_clear();
+  fio_histogram(FIO_HISTOGRAM_TIMER, &h);
+  FIO_ASSERT(!h.count && !fio_histogram_percentile(&h, 99),
+             "histogram not cleared");
+  fprintf(stderr, "* passed.\n");
+}
+
+/* *****************************************************************************
+Read Buffer Pool Testing
+***************************************************************************** */
+
+FIO_FUNC void fio_buffer_pool_test(void) {
+  fprintf(stderr, "=== Testing the read buffer pool\n");
+  void *b = fio_buffer_borrow(1);
+  FIO_ASSERT(b && fio_buffer_capacity(b) == 4096,
+             "buffer pool minimal size class error");
+  memset(b, 1, 4096);
+  fio_buffer_return(b);
+  FIO_ASSERT(fio_buffer_borrow(4096) == b,
+             "buffer pool thread cache should reuse returned buffers");
+  fio_buffer_return(b);
+  b = fio_buffer_borrow(4097);
+  FIO_ASSERT(b && fio_buffer_capacity(b) == 8192, "buffer pool class error");
+  fio_buffer_return(b);
+  b = fio_buffer_borrow((1UL << 16) + 1);
+  FIO_ASSERT(b && fio_buffer_capacity(b) == (1UL << 16) + 4096,
+             "buffer pool large buffer size error");
+  memset(b, 1, fio_buffer_capacity(b));
+  fio_buffer_return(b);
+  fio_buffer_return(NULL);
+  FIO_ASSERT(!fio_buffer_capacity(NULL), "buffer pool NULL capacity error");
+  fio_buffer_pool_clear();
+  fprintf(stderr, "* passed.\n");
+}
+
+FIO_FUNC void fio_fd_data_test(void) {
+  fprintf(stderr, "=== Testing the connection table\n");
+  const uintptr_t limit = fio_data->fd_limit;
+  FIO_ASSERT(limit && !(limit & FIO_FD_PAGE_MASK),
+             "connection table should grow a page at a time");
+  fio_fd_data_s *first = &fd_data(0);
+  FIO_ASSERT(!fio_fd_data_reserve(limit - 1) && fio_data->fd_limit == limit,
+             "reserving an existing entry shouldn't grow the table");
+  if (limit < fio_data->capa) {
+    FIO_ASSERT(!fio_fd_data_reserve(limit) &&
+                   fio_data->fd_limit == limit + FIO_FD_PAGE_SIZE,
+               "connection table didn't grow");
+    FIO_ASSERT(fd_cold(limit).fd == limit && !fd_data(limit).open &&
+                   fd_data(limit).rw_hooks == &FIO_DEFAULT_RW_HOOKS,
+               "new connection table entries should be initialized");
+  }
+  FIO_ASSERT(first == &fd_data(0), "connection table entries moved");
+  FIO_ASSERT(sizeof(fio_fd_data_s) == 64 && !((uintptr_t)first & 63),
+             "connection data should fit (and be aligned to) a cache line");
+  errno = 0;
+  FIO_ASSERT(fio_fd_data_reserve(fio_data->capa) == -1 && errno == EMFILE,
+             "connection table should be limited by it's capacity");
+  fprintf(stderr, "* passed.\n");
+}
+
+static fio_mutex_i fio_mutex_test_lock = FIO_MUTEX_INIT;
+static size_t fio_mutex_test_count;
+
+static void *fio_mutex_test_task(void *arg) {
+  for (size_t i = 0; i < 100000; ++i) {
+    fio_mutex_lock(&fio_mutex_test_lock);
+    ++fio_mutex_test_count;
+    if (!(i & 1023))
+      fio_reschedule_thread(); /* make sure other threads sleep on the lock */
+    fio_mutex_unlock(&fio_mutex_test_lock);
+  }
+  return arg;
+}
+
+FIO_FUNC void fio_mutex_test(void) {
+  fprintf(stderr, "=== Testing the adaptive lock\n");
+  void *threads[4];
+  FIO_ASSERT(!fio_mutex_trylock(&fio_mutex_test_lock),
+             "adaptive lock trylock failed");
+  FIO_ASSERT(fio_mutex_trylock(&fio_mutex_test_lock),
+             "adaptive lock trylock should fail while locked");
+  fio_mutex_unlock(&fio_mutex_test_lock);
+  FIO_ASSERT(!fio_mutex_test_lock, "adaptive lock should be unlocked");
+  for (size_t i = 0; i < 4; ++i) {
+    threads[i] = fio_thread_new(fio_mutex_test_task, NULL);
+    FIO_ASSERT(threads[i], "couldn't spawn adaptive lock test thread");
+  }
+  for (size_t i = 0; i < 4; ++i) {
+    fio_thread_join(threads[i]);
+  }
+  FIO_ASSERT(fio_mutex_test_count == 400000,
+             "adaptive lock failed to protect the critical section (%zu)",
+             fio_mutex_test_count);
+  FIO_ASSERT(!fio_mutex_test_lock, "adaptive lock should be unlocked");
+  fprintf(stderr, "* passed.\n");
+}
+
 /* *****************************************************************************
 Run all tests
 ***************************************************************************** */
@@ -11020,6 +15064,10 @@ void fio_test(void) {
   fio_set_test();
   fio_defer_test();
   fio_timer_test();
+  fio_histogram_test();
+  fio_buffer_pool_test();
+  fio_fd_data_test();
+  fio_mutex_test();
   fio_poll_test();
   fio_socket_test();
   fio_uuid_link_test();
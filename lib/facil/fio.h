@@ -131,29 +131,42 @@ Version and helper macros
 #ifndef FIO_MAX_SOCK_CAPACITY
 /**
  * The maximum number of connections per worker process.
+ *
+ * The connection table is allocated on demand, so a high value costs very
+ * little memory until connections are actually opened.
  */
-#define FIO_MAX_SOCK_CAPACITY 131072
+#define FIO_MAX_SOCK_CAPACITY 4194304
 #endif
 
 #ifndef FIO_CPU_CORES_LIMIT
 /**
- * If facil.io detects more CPU cores than the number of cores stated in the
- * FIO_CPU_CORES_LIMIT, it will assume an error and cap the number of cores
- * detected to the assigned limit.
- *
- * This is only relevant to automated values, when running facil.io with zero
- * threads and processes, which invokes a large matrix of workers and threads
- * (see {facil_run})
+ * The maximum number of threads per worker process when facil.io auto-detects
+ * the concurrency matrix (when running facil.io with zero threads and
+ * processes, see {fio_start}).
  *
- * The default auto-detection cap is set at 8 cores. The number is arbitrary
- * (historically the number 7 was used after testing `malloc` race conditions on
- * a MacBook Pro).
+ * The number of workers follows the number of usable CPU cores (as limited by
+ * the affinity mask, cpusets and CFS quotas), but the threads per worker are
+ * capped at this limit, so large machines don't end up with a cores*cores
+ * thread count. Set to zero to disable the cap.
  *
  * This does NOT effect manually set (non-zero) worker/thread values.
  */
 #define FIO_CPU_CORES_LIMIT 8
 #endif
 
+#ifndef FIO_WORKER_MEMORY_MIN
+/**
+ * The minimal memory (in bytes) reserved for every auto-detected worker process
+ * when the process runs under a memory limit (i.e., a cgroup `memory.max`).
+ *
+ * Auto-detected worker counts are reduced so that every worker has at least
+ * this much memory. Set to zero to ignore memory limits.
+ *
+ * This does NOT effect manually set (positive) worker values.
+ */
+#define FIO_WORKER_MEMORY_MIN (64UL * 1024 * 1024)
+#endif
+
 #ifndef FIO_DEFER_THROTTLE_PROGRESSIVE
 /**
  * The progressive throttling model makes concurrency and parallelism more
@@ -216,6 +229,7 @@ Version and helper macros
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #if !defined(__GNUC__) && !defined(__clang__) && !defined(FIO_GNUC_BYPASS)
@@ -243,6 +257,11 @@ Version and helper macros
 #include <sys/socket.h>
 #endif
 
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
 /* *****************************************************************************
 Patch for OSX version < 10.12 from https://stackoverflow.com/a/9781275/4025095
 ***************************************************************************** */
@@ -586,6 +605,33 @@ struct fio_protocol_s {
   void (*on_close)(intptr_t uuid, fio_protocol_s *protocol);
   /** called when a connection's timeout was reached */
   void (*ping)(intptr_t uuid, fio_protocol_s *protocol);
+  /**
+   * Called when more data than the high watermark is waiting in the
+   * connection's outgoing queue (see `fio_watermarks_set`).
+   *
+   * Data producers (i.e., pub/sub fan-out, SSE, proxies) should stop writing
+   * until `on_drained` is called, rather than buffering the data in memory.
+   *
+   * The callback runs within a {FIO_PR_LOCK_WRITE} lock. It's optional.
+   */
+  void (*on_congested)(intptr_t uuid, fio_protocol_s *protocol);
+  /**
+   * Called when a congested connection's outgoing queue drained to (or below)
+   * the low watermark.
+   *
+   * The callback runs within a {FIO_PR_LOCK_WRITE} lock. It's optional.
+   */
+  void (*on_drained)(intptr_t uuid, fio_protocol_s *protocol);
+  /**
+   * The connection's outgoing queue high watermark (in bytes), set when the
+   * protocol is attached (see `fio_attach` and `fio_watermarks_set`).
+   *
+   * If zero, new connections use the default (`FIO_WATERMARK_HIGH`) and
+   * replaced protocols keep the connection's watermarks.
+   */
+  size_t watermark_high;
+  /** The outgoing queue low watermark (in bytes), see `watermark_high`. */
+  size_t watermark_low;
   /** private metadata used by facil. */
   size_t rsv;
 };
@@ -598,6 +644,8 @@ struct fio_protocol_s {
  *
  * The old protocol's `on_close` (if any) will be scheduled.
  *
+ * The new protocol's watermarks (if set) are applied to the connection.
+ *
  * On error, the new protocol's `on_close` callback will be called immediately.
  */
 void fio_attach(intptr_t uuid, fio_protocol_s *protocol);
@@ -646,6 +694,48 @@ void fio_timeout_set(intptr_t uuid, uint8_t timeout);
 /** Gets a timeout for a specific connection. Returns 0 if none. */
 uint8_t fio_timeout_get(intptr_t uuid);
 
+/**
+ * Sets the CPU time (in microseconds) a connection's `on_data` callback may
+ * consume during a single reactor cycle (0 == unlimited).
+ *
+ * The thread's CPU time is measured (`CLOCK_THREAD_CPUTIME_ID`), so time spent
+ * blocking or preempted isn't charged against the budget.
+ *
+ * Once the budget is exhausted, any forced `on_data` events (see
+ * `fio_force_event`) are postponed to the next reactor cycle, after the events
+ * of other connections.
+ *
+ * This protects the latency of other connections from greedy clients (i.e.,
+ * heavy HTTP pipelining or bulk WebSocket uploads).
+ */
+void fio_budget_set(intptr_t uuid, uint32_t microseconds);
+
+/** Gets a connection's `on_data` CPU budget. Returns 0 if none. */
+uint32_t fio_budget_get(intptr_t uuid);
+
+/**
+ * Sets a connection's outgoing queue watermarks (in bytes).
+ *
+ * When more than `high` bytes are waiting in the outgoing queue, the
+ * connection is marked as congested and the protocol's `on_congested` callback
+ * is scheduled. Once the queue drains to (or below) `low` bytes, the
+ * `on_drained` callback is scheduled.
+ *
+ * `fio_attach` sets the defaults (`FIO_WATERMARK_HIGH` and `FIO_WATERMARK_LOW`)
+ * when a protocol is attached to a new connection. A `high` value of zero
+ * disables congestion tracking.
+ */
+void fio_watermarks_set(intptr_t uuid, size_t high, size_t low);
+
+/** Returns the number of bytes waiting in a connection's outgoing queue. */
+size_t fio_pending_bytes(intptr_t uuid);
+
+/**
+ * Returns true if a connection's outgoing queue is congested (it grew beyond
+ * the high watermark and didn't drain to the low watermark yet).
+ */
+int fio_is_congested(intptr_t uuid);
+
 /**
  * "Touches" a socket connection, resetting it's timeout counter.
  */
@@ -706,6 +796,20 @@ struct fio_listen_args {
    *
    * This will be called separately for every process. */
   void (*on_finish)(intptr_t uuid, void *udata);
+  /**
+   * If true, every worker process listens using it's own socket
+   * (`SO_REUSEPORT`), allowing the kernel to balance incoming connections
+   * between the workers instead of waking all of them.
+   *
+   * Ignored for Unix sockets, when `SO_REUSEPORT` is unavailable or when
+   * `fio_listen` is called after the server started.
+   */
+  uint8_t reuse_port;
+  /**
+   * The `on_data` CPU budget (in microseconds per reactor cycle) for every
+   * accepted connection. See `fio_budget_set`. Defaults to 0 (unlimited).
+   */
+  uint32_t on_data_budget;
 };
 
 /**
@@ -939,6 +1043,59 @@ struct fio_start_args {
   int16_t threads;
   /** The number of worker processes to run. See `threads`. */
   int16_t workers;
+  /**
+   * If true, every thread polls it's own set of connections and performs their
+   * IO events (`on_data`, `on_ready`) directly, instead of scheduling them
+   * using the shared task queue. Connections are assigned to threads
+   * according to their file descriptor.
+   *
+   * The shared task queue is still used for `fio_defer`, timers, pub/sub and
+   * other cross-thread tasks.
+   *
+   * Requires `epoll` and more than a single thread (otherwise ignored).
+   */
+  uint8_t reactor_per_thread;
+  /**
+   * If true, every worker process is pinned to a set of CPU cores.
+   *
+   * On machines with more than a single NUMA node, each worker is pinned to a
+   * NUMA node (round robin). Otherwise the available CPU cores are split
+   * between the worker processes.
+   *
+   * Requires Linux (otherwise ignored). Has no effect in single process mode.
+   */
+  uint8_t pin_workers;
+  /**
+   * If true, every thread is pinned to a single CPU core (within the worker's
+   * set of cores) and prefers the memory allocator's arena for that core.
+   *
+   * Requires Linux (otherwise ignored).
+   */
+  uint8_t pin_threads;
+  /**
+   * The maximum number of threads the (adaptive) thread pool may grow to.
+   *
+   * When greater than `threads`, the thread pool spawns extra threads while
+   * tasks are left waiting with all threads busy (i.e., blocked by DNS, disk
+   * access or user code) for longer than `grow_delay`. Extra threads retire
+   * after idling for `idle_timeout`, down to `threads`.
+   *
+   * Zero (the default) keeps the thread pool size fixed. Ignored in
+   * `reactor_per_thread` mode.
+   */
+  int16_t max_threads;
+  /**
+   * Milliseconds of queue pressure before an adaptive thread pool grows.
+   *
+   * Defaults to `FIO_DEFER_POOL_GROW_DELAY` (10ms).
+   */
+  uint16_t grow_delay;
+  /**
+   * Seconds an extra thread may idle before an adaptive thread pool retires it.
+   *
+   * Defaults to `FIO_DEFER_POOL_IDLE_TIMEOUT` (30 seconds).
+   */
+  uint16_t idle_timeout;
 };
 
 /**
@@ -1020,10 +1177,129 @@ void fio_signal_handler_reset(void);
  */
 struct timespec fio_last_tick(void);
 
+/** Runtime statistics for the current process, see `fio_stats`. */
+typedef struct {
+  /** Tasks waiting in the task queues (including thread local queues). */
+  size_t tasks_pending;
+  /** Task queue blocks allocated (beyond the statically allocated blocks). */
+  size_t queue_blocks;
+  /** Open connections (including listening sockets). */
+  size_t connections;
+  /** Outgoing packets waiting in the connections' outgoing queues. */
+  size_t packets_pending;
+  /** Outgoing bytes waiting in the connections' outgoing queues. */
+  size_t bytes_pending;
+  /** Timers waiting in the timing wheel (see `fio_run_every`). */
+  size_t timers_pending;
+  /** The number of IO polling calls (reactor cycles). */
+  size_t poll_calls;
+  /** IO events returned by all polling calls (divide by `poll_calls`). */
+  size_t poll_events;
+  /**
+   * System calls used to (re)arm IO events (`epoll_ctl` / `kevent`).
+   *
+   * Always 0 for the `poll` and `io_uring` engines.
+   */
+  size_t poll_arms;
+  /** Read system calls made by `fio_read` (including ones that found no data). */
+  size_t read_calls;
+  /** Bytes read using `fio_read` (through the read hook). */
+  size_t bytes_read;
+  /** Bytes written from the outgoing queues (through the write hooks). */
+  size_t bytes_written;
+  /** The number of times idle threads were parked (suspended). */
+  size_t thread_parks;
+  /**
+   * System calls used to wake parked threads.
+   *
+   * Always 0 unless threads are parked on a `futex` (see `FIO_THREAD_FUTEX`).
+   */
+  size_t thread_wakes;
+} fio_stats_s;
+
+/**
+ * Returns the current process's runtime statistics.
+ *
+ * Counters (polling, bytes read / written) are collected per thread and
+ * aggregated on demand, so they are always on. Queue, timer and connection
+ * states are reviewed during the call, which is `O(n)` in the number of open
+ * connections - avoid calling `fio_stats` in a tight loop.
+ *
+ * Statistics are per process. Counters restart after forking.
+ */
+fio_stats_s fio_stats(void);
+
+/** The latency histograms collected by facil.io, see `fio_histogram`. */
+typedef enum {
+  /** The time tasks wait in the task queue before they're performed. */
+  FIO_HISTOGRAM_QUEUE_WAIT,
+  /** The execution time of `on_data` callbacks. */
+  FIO_HISTOGRAM_ON_DATA,
+  /** The execution time of `on_ready` callbacks. */
+  FIO_HISTOGRAM_ON_READY,
+  /** The execution time of timer tasks (see `fio_run_every`). */
+  FIO_HISTOGRAM_TIMER,
+  /** The execution time of pub/sub `on_message` callbacks. */
+  FIO_HISTOGRAM_PUBSUB,
+  /** The time spent polling for IO events (including any waiting). */
+  FIO_HISTOGRAM_POLL,
+  /** The number of histogram types (not a histogram). */
+  FIO_HISTOGRAM_TYPES
+} fio_histogram_e;
+
+/**
+ * The number of buckets in a latency histogram.
+ *
+ * Values below 4ns have their own bucket. Larger values are split into 4
+ * buckets per power of 2, so the highest bucket starts at ~18 minutes.
+ */
+#define FIO_HISTOGRAM_BUCKETS 160
+
+/** A latency histogram, all values are in nanoseconds. */
+typedef struct {
+  /** The number of values recorded. */
+  size_t count;
+  /** The sum of all values recorded (used to calculate the mean). */
+  size_t total;
+  /** The highest value recorded. */
+  size_t max;
+  /** The number of values per bucket. */
+  size_t buckets[FIO_HISTOGRAM_BUCKETS];
+} fio_histogram_s;
+
+/**
+ * Collects a latency histogram for the current process, merging the per
+ * thread histograms into `dest`.
+ *
+ * Histograms are always on unless facil.io was compiled with
+ * `FIO_HISTOGRAMS == 0`, in which case the histogram will be empty.
+ */
+void fio_histogram(fio_histogram_e type, fio_histogram_s *dest);
+
+/**
+ * Returns the (approximate) value, in nanoseconds, at a percentile (0-100) of
+ * the histogram, i.e., `fio_histogram_percentile(&h, 99)` returns the p99.
+ *
+ * The value is the highest value of the matching bucket (or the maximum),
+ * which is accurate to ~25%.
+ */
+size_t fio_histogram_percentile(fio_histogram_s *h, double percentile);
+
+/** Clears all the latency histograms for the current process. */
+void fio_histogram_clear(void);
+
+/**
+ * Logs a summary of all the latency histograms (using `FIO_LOG_INFO`).
+ *
+ * Periodic summaries can be scheduled using `fio_run_every` or by compiling
+ * facil.io with `FIO_HISTOGRAM_LOG_INTERVAL` (milliseconds).
+ */
+void fio_histogram_log(void);
+
 /**
  * Returns a C string detailing the IO engine selected during compilation.
  *
- * Valid values are "kqueue", "epoll" and "poll".
+ * Valid values are "kqueue", "epoll", "io_uring" and "poll".
  */
 char const *fio_engine(void);
 
@@ -1177,8 +1453,11 @@ typedef struct {
    *  `.data.fd = fd` or `.data.buffer = (void*)fd;`
    */
   unsigned is_fd : 1;
-  /** for internal use */
-  unsigned rsv : 1;
+  /**
+   * The buffer is copied (it remains owned by the caller and `dealloc` is
+   * ignored). Small copies are coalesced into the last queued packet.
+   */
+  unsigned copy : 1;
   /** for internal use */
   unsigned rsv2 : 1;
 } fio_write_args_s;
@@ -1224,12 +1503,7 @@ inline FIO_FUNC ssize_t fio_write(const intptr_t uuid, const void *buffer,
                                   const size_t length) {
   if (!length || !buffer)
     return 0;
-  void *cpy = fio_malloc(length);
-  if (!cpy)
-    return -1;
-  memcpy(cpy, buffer, length);
-  return fio_write2(uuid, .data.buffer = cpy, .length = length,
-                    .after.dealloc = fio_free);
+  return fio_write2(uuid, .data.buffer = buffer, .length = length, .copy = 1);
 }
 
 /**
@@ -1254,8 +1528,12 @@ inline FIO_FUNC ssize_t fio_sendfile(intptr_t uuid, intptr_t source_fd,
 }
 
 /**
- * Returns the number of `fio_write` calls that are waiting in the socket's
- * queue and haven't been processed.
+ * Returns the number of packets that are waiting in the socket's queue and
+ * haven't been processed.
+ *
+ * Small copied writes (`fio_write`) are coalesced into a single packet, so this
+ * might be less than the number of `fio_write` calls. Use `fio_pending_bytes`
+ * for the amount of data waiting in the queue.
  */
 size_t fio_pending(intptr_t uuid);
 
@@ -1285,6 +1563,63 @@ ssize_t fio_flush(intptr_t uuid);
  */
 size_t fio_flush_all(void);
 
+/**
+ * Enables zero-copy transmission (`MSG_ZEROCOPY`) for buffers of `threshold`
+ * bytes or more (0 disables zero-copy transmission for the connection).
+ *
+ * The buffer's `dealloc` function is called only after the kernel reports
+ * that it's done with the data, so the buffer must remain unchanged until
+ * then.
+ *
+ * Zero-copy transmission is only worthwhile for large buffers (~10Kb and up)
+ * and it's automatically disabled if the kernel falls back to copying the data
+ * (i.e., when sending to the loopback device).
+ *
+ * Only available on Linux, using the `epoll` or `io_uring` engines, for
+ * connections with the default read/write hooks.
+ *
+ * Returns -1 on error (or if unsupported). Returns 0 on success.
+ */
+int fio_zerocopy_set(intptr_t uuid, size_t threshold);
+
+/** Named arguments for the `fio_splice` function. */
+struct fio_splice_args {
+  /** Called once both connections were closed (the tunnel is gone). */
+  void (*on_close)(void *udata);
+  /** Opaque user data for the `on_close` callback. */
+  void *udata;
+  /**
+   * The maximum number of bytes moved per event in each direction.
+   *
+   * Defaults to `FIO_SPLICE_CHUNK` (64Kb).
+   */
+  size_t chunk;
+};
+
+/**
+ * Forwards data between two connections, in both directions, until either
+ * connection closes (the other connection is closed once it's outgoing queue
+ * was sent).
+ *
+ * Both connections are attached to internal protocol objects, replacing any
+ * existing protocols (i.e., a connection hijacked with `http_hijack` and a
+ * backend connection opened with `fio_connect`). Leftover data (such as data
+ * returned by `http_hijack`) should be written before calling `fio_splice`.
+ *
+ * On Linux, data is moved using `splice` through a pipe pair, so it never
+ * reaches user space. Data is never spliced ahead of packets already waiting in
+ * the connection's outgoing queue. If either connection uses read/write hooks
+ * (i.e., TLS), data is read using `fio_read` and copied to the other
+ * connection's outgoing queue, suspending the reading side while the other
+ * connection is congested (see `fio_watermarks_set`).
+ *
+ * Returns -1 on error (invalid `uuid`, neither connection is attached).
+ * Returns 0 on success.
+ */
+int fio_splice(intptr_t uuid_a, intptr_t uuid_b, struct fio_splice_args args);
+#define fio_splice(uuid_a, uuid_b, ...)                                        \
+  fio_splice((uuid_a), (uuid_b), (struct fio_splice_args){__VA_ARGS__})
+
 /**
  * Convert between a facil.io connection's identifier (uuid) and system's fd.
  */
@@ -1413,6 +1748,22 @@ typedef struct fio_rw_hook_s {
    * This callback is always called, even if `fio_rw_hook_set` fails.
    * */
   void (*cleanup)(void *udata);
+  /**
+   * Implement vectored writing to a file descriptor. Should behave like the
+   * file system `writev` call.
+   *
+   * When implemented, `fio_flush` will gather consecutive queued buffers
+   * (up to `FIO_FLUSH_IOV_MAX`) and send them using a single call.
+   *
+   * If `NULL`, the `write` callback will be called once per queued buffer. The
+   * system's `writev` is used only if the `write` callback is also the
+   * default one.
+   *
+   * Note: facil.io library functions MUST NEVER be called by any r/w hook, or a
+   * deadlock might occur.
+   */
+  ssize_t (*writev)(intptr_t uuid, void *udata, const struct iovec *iov,
+                    int iovcnt);
 } fio_rw_hook_s;
 
 /** Sets a socket hook state (a pointer to the struct). */
@@ -1438,6 +1789,38 @@ int fio_rw_hook_replace_unsafe(intptr_t uuid, fio_rw_hook_s *rw_hooks,
 /** The default Read/Write hooks used for system Read/Write (udata == NULL). */
 extern const fio_rw_hook_s FIO_DEFAULT_RW_HOOKS;
 
+/* *****************************************************************************
+Read Buffer Pool
+
+Protocols that need a read buffer only while a message is partially consumed
+can borrow one from a shared pool instead of embedding a buffer in every
+connection, returning the buffer once the parser reaches a message boundary.
+
+Buffers are pooled by size class (4Kb, 8Kb, 16Kb, 32Kb and 64Kb), with a small
+per-thread cache (`FIO_BUFFER_POOL_CACHE`) in front of a shared free list
+(`FIO_BUFFER_POOL_LIMIT` buffers per size class). Larger buffers are allocated
+and freed directly.
+***************************************************************************** */
+
+/**
+ * Borrows a buffer with a capacity of (at least) `size` bytes.
+ *
+ * Use `fio_buffer_capacity` to learn the actual capacity of the buffer.
+ *
+ * Returns NULL on error (no memory).
+ */
+void *fio_buffer_borrow(size_t size);
+
+/**
+ * Returns a buffer (borrowed using `fio_buffer_borrow`) to the pool.
+ *
+ * Buffers can be returned by any thread. NULL is silently ignored.
+ */
+void fio_buffer_return(void *buffer);
+
+/** Returns the capacity of a buffer borrowed using `fio_buffer_borrow`. */
+size_t fio_buffer_capacity(void *buffer);
+
 /* *****************************************************************************
 Concurrency overridable functions
 
@@ -1546,22 +1929,44 @@ Event / Task scheduling
  * nothing (void) and accept two opaque `void *` pointers, user-data 1
  * (`udata1`) and user-data 2 (`udata2`).
  *
+ * Tasks deferred by a thread pool's thread are placed in the thread's local
+ * queue and performed in order (FIFO), before the shared queue's tasks. Idle
+ * threads might steal these tasks, so tasks deferred by different threads might
+ * run concurrently.
+ *
  * Returns -1 or error, 0 on success.
  */
 int fio_defer(void (*task)(void *, void *), void *udata1, void *udata2);
 
+/** An opaque timer handle, returned by `fio_run_every`. */
+typedef struct fio_timer_s fio_timer_s;
+
 /**
  * Creates a timer to run a task at the specified interval.
  *
  * The task will repeat `repetitions` times. If `repetitions` is set to 0, task
  * will repeat forever.
  *
- * Returns -1 on error.
+ * Returns a timer handle that can be used to cancel the timer (see
+ * `fio_timer_cancel`), or NULL on error.
+ *
+ * The handle is valid until the `on_finish` handler is called.
  *
  * The `on_finish` handler is always called (even on error).
  */
-int fio_run_every(size_t milliseconds, size_t repetitions, void (*task)(void *),
-                  void *arg, void (*on_finish)(void *));
+fio_timer_s *fio_run_every(size_t milliseconds, size_t repetitions,
+                           void (*task)(void *), void *arg,
+                           void (*on_finish)(void *));
+
+/**
+ * Cancels a timer, so it's task will not be performed again.
+ *
+ * The `on_finish` handler will be called (possibly during this call) and the
+ * timer handle will be invalidated.
+ *
+ * Returns -1 on error (i.e., if the timer was already canceled).
+ */
+int fio_timer_cancel(fio_timer_s *timer);
 
 /**
  * Performs all deferred tasks.
@@ -2079,6 +2484,35 @@ FIO_FUNC inline int fio_is_locked(fio_lock_i *lock);
 /** Busy waits for the spinlock (CAREFUL). */
 FIO_FUNC inline void fio_lock(fio_lock_i *lock);
 
+/**
+ * An adaptive lock, for critical sections that might be held for a while (or
+ * that might perform system calls).
+ *
+ * A contended lock spins briefly and then sleeps until the lock is released
+ * (using `futex` on Linux), instead of rescheduling the thread in a loop.
+ *
+ * The spinlock (`fio_lock_i`) is still preferred for very short critical
+ * sections.
+ */
+typedef uint32_t volatile fio_mutex_i;
+
+/** The initail value of an unlocked adaptive lock. */
+#define FIO_MUTEX_INIT 0
+
+#ifndef FIO_MUTEX_SPIN
+/** The number of attempts made before a contended adaptive lock sleeps. */
+#define FIO_MUTEX_SPIN 100
+#endif
+
+/** returns 0 if the lock was acquired and a non-zero value on failure. */
+FIO_FUNC inline int fio_mutex_trylock(fio_mutex_i *lock);
+
+/** Waits for the adaptive lock (spinning briefly before sleeping). */
+FIO_FUNC inline void fio_mutex_lock(fio_mutex_i *lock);
+
+/** Releases an adaptive lock, waking up a waiting thread (if any). */
+FIO_FUNC inline void fio_mutex_unlock(fio_mutex_i *lock);
+
 /**
  * Nanosleep seems to be the most effective and efficient thread rescheduler.
  */
@@ -3022,6 +3456,68 @@ FIO_FUNC inline void fio_lock(fio_lock_i *lock) {
   }
 }
 
+/* *****************************************************************************
+Adaptive lock implementation
+
+The lock's state is 0 (unlocked), 1 (locked) or 2 (locked, might have waiting
+threads), so an uncontended unlock never performs a system call.
+***************************************************************************** */
+
+/* a CPU hint for spin-wait loops */
+FIO_FUNC inline void fio_mutex_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __asm__ volatile("pause" ::: "memory");
+#elif defined(__aarch64__)
+  __asm__ volatile("yield" ::: "memory");
+#else
+  __asm__ volatile("" ::: "memory");
+#endif
+}
+
+/* waits while the lock's state is `state` (spurious wake ups are okay) */
+FIO_FUNC inline void fio_mutex_wait(fio_mutex_i *lock, uint32_t state) {
+#if defined(__linux__) && defined(SYS_futex)
+  syscall(SYS_futex, lock, FUTEX_WAIT_PRIVATE, state, NULL, NULL, 0);
+#else
+  (void)lock;
+  (void)state;
+  fio_reschedule_thread();
+#endif
+}
+
+/* wakes up a thread waiting for the lock */
+FIO_FUNC inline void fio_mutex_wake(fio_mutex_i *lock) {
+#if defined(__linux__) && defined(SYS_futex)
+  syscall(SYS_futex, lock, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+  (void)lock;
+#endif
+}
+
+/** returns 0 if the lock was acquired and a non-zero value on failure. */
+FIO_FUNC inline int fio_mutex_trylock(fio_mutex_i *lock) {
+  return (int)__sync_val_compare_and_swap(lock, 0, 1);
+}
+
+/** Waits for the adaptive lock (spinning briefly before sleeping). */
+FIO_FUNC inline void fio_mutex_lock(fio_mutex_i *lock) {
+  for (size_t i = 0; i < FIO_MUTEX_SPIN; ++i) {
+    if (!*lock && !__sync_val_compare_and_swap(lock, 0, 1))
+      return;
+    fio_mutex_cpu_relax();
+  }
+  /* mark the lock as contended, so the owner will wake us up */
+  while (fio_atomic_xchange(lock, 2)) {
+    fio_mutex_wait(lock, 2);
+  }
+}
+
+/** Releases an adaptive lock, waking up a waiting thread (if any). */
+FIO_FUNC inline void fio_mutex_unlock(fio_mutex_i *lock) {
+  if (fio_atomic_xchange(lock, 0) == 2)
+    fio_mutex_wake(lock);
+}
+
 #if DEBUG_SPINLOCK
 /** Busy waits for a lock, reports contention. */
 FIO_FUNC inline void fio_lock_dbg(fio_lock_i *lock, const char *file,
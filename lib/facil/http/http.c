@@ -930,7 +930,8 @@ intptr_t http_listen(const char *port, const char *binding,
 
   return fio_listen(.port = port, .address = binding, .tls = arg_settings.tls,
                     .on_finish = http_on_finish, .on_open = http_on_open,
-                    .udata = settings);
+                    .udata = settings, .reuse_port = arg_settings.reuse_port,
+                    .on_data_budget = arg_settings.on_data_budget);
 }
 /** Listens to HTTP connections at the specified `port` and `binding`. */
 #define http_listen(port, binding, ...)                                        \
@@ -401,6 +401,18 @@ struct http_settings_s {
   uint8_t ws_timeout;
   /** Logging flag - set to TRUE to log HTTP requests. */
   uint8_t log;
+  /**
+   * Set to TRUE for each worker process to listen using it's own socket
+   * (`SO_REUSEPORT`). See `fio_listen` for details.
+   */
+  uint8_t reuse_port;
+  /**
+   * The CPU time (in microseconds) a connection's `on_data` may consume per
+   * reactor cycle before it's postponed behind other connections (this
+   * includes WebSocket connections). See `fio_budget_set`. Defaults to 0
+   * (unlimited).
+   */
+  uint32_t on_data_budget;
   /** a read only flag set automatically to indicate the protocol's mode. */
   uint8_t is_client;
 };
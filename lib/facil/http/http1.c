@@ -28,7 +28,8 @@ typedef struct http1pr_s {
   uint8_t close;
   uint8_t is_client;
   uint8_t stop;
-  uint8_t buf[];
+  /** read buffer, borrowed only while data is partially consumed */
+  uint8_t *buf;
 } http1pr_s;
 
 struct http_vtable_s HTTP1_VTABLE; /* initialized later on */
@@ -37,6 +38,28 @@ struct http_vtable_s HTTP1_VTABLE; /* initialized later on */
 Internal Helpers
 ***************************************************************************** */
 
+/* borrows a read buffer (if missing). Returns -1 on error (no memory). */
+static inline int http1_buffer_borrow(http1pr_s *p) {
+  if (!p->buf)
+    p->buf = fio_buffer_borrow(HTTP_MAX_HEADER_LENGTH);
+  return 0 - !p->buf;
+}
+
+/* returns the read buffer to the pool once all data was consumed */
+static inline void http1_buffer_release(http1pr_s *p) {
+  if (p->buf_len || p->stop)
+    return;
+  fio_buffer_return(p->buf);
+  p->buf = NULL;
+}
+
+/* the length of any data following the current request (upgrade / hijack) */
+static inline intptr_t http1_leftover_length(http1pr_s *p) {
+  if (!p->buf)
+    return 0;
+  return p->buf_len - (intptr_t)(p->parser.state.next - p->buf);
+}
+
 #define parser2http(x)                                                         \
   ((http1pr_s *)((uintptr_t)(x) - (uintptr_t)(&((http1pr_s *)0)->parser)))
 
@@ -267,9 +290,7 @@ static void http1_on_resume(http_s *h, http_fio_protocol_s *pr) {
 
 static intptr_t http1_hijack(http_s *h, fio_str_info_s *leftover) {
   if (leftover) {
-    intptr_t len =
-        handle2pr(h)->buf_len -
-        (intptr_t)(handle2pr(h)->parser.state.next - handle2pr(h)->buf);
+    intptr_t len = http1_leftover_length(handle2pr(h));
     if (len) {
       *leftover = (fio_str_info_s){
           .len = len, .data = (char *)handle2pr(h)->parser.state.next};
@@ -298,7 +319,7 @@ static void http1_websocket_client_on_upgrade(http_s *h, char *proto,
   http_finish(h);
   p->stop = 1;
   websocket_attach(uuid, set, args, p->parser.state.next,
-                   p->buf_len - (intptr_t)(p->parser.state.next - p->buf));
+                   http1_leftover_length(p));
   fio_free(args);
   (void)proto;
   (void)len;
@@ -359,7 +380,7 @@ static int http1_http2websocket_server(http_s *h, websocket_settings_s *args) {
   http_finish(h);
   pr->stop = 1;
   websocket_attach(uuid, set, args, pr->parser.state.next,
-                   pr->buf_len - (intptr_t)(pr->parser.state.next - pr->buf));
+                   http1_leftover_length(pr));
   return 0;
 bad_request:
   http_send_error(h, 400);
@@ -678,7 +699,11 @@ Connection Callbacks
 ***************************************************************************** */
 
 static inline void http1_consume_data(intptr_t uuid, http1pr_s *p) {
-  if (fio_pending(uuid) > 4) {
+  /*
+   * Small responses are coalesced into shared packets, so the packet count
+   * alone might allow many pipelined responses - limit the bytes as well.
+   */
+  if (fio_pending(uuid) > 4 || fio_pending_bytes(uuid) > 16384) {
     goto throttle;
   }
   ssize_t i = 0;
@@ -737,6 +762,10 @@ static void http1_on_data(intptr_t uuid, fio_protocol_s *protocol) {
     return;
   }
   ssize_t i = 0;
+  if (http1_buffer_borrow(p)) {
+    fio_close(uuid);
+    return;
+  }
   if (HTTP_MAX_HEADER_LENGTH - p->buf_len)
     i = fio_read(uuid, p->buf + p->buf_len,
                  HTTP_MAX_HEADER_LENGTH - p->buf_len);
@@ -744,6 +773,7 @@ static void http1_on_data(intptr_t uuid, fio_protocol_s *protocol) {
     p->buf_len += i;
   }
   http1_consume_data(uuid, p);
+  http1_buffer_release(p);
 }
 
 /** called when the connection was closed, but will not run concurrently */
@@ -768,10 +798,16 @@ static void http1_on_data_first_time(intptr_t uuid, fio_protocol_s *protocol) {
   http1pr_s *p = (http1pr_s *)protocol;
   ssize_t i;
 
+  if (http1_buffer_borrow(p)) {
+    fio_close(uuid);
+    return;
+  }
   i = fio_read(uuid, p->buf + p->buf_len, HTTP_MAX_HEADER_LENGTH - p->buf_len);
 
-  if (i <= 0)
+  if (i <= 0) {
+    http1_buffer_release(p);
     return;
+  }
   p->buf_len += i;
 
   /* ensure future reads skip this first time HTTP/2.0 test */
@@ -784,6 +820,7 @@ static void http1_on_data_first_time(intptr_t uuid, fio_protocol_s *protocol) {
 
   /* Finish handling the same way as the normal `on_data` */
   http1_consume_data(uuid, p);
+  http1_buffer_release(p);
 }
 
 /* *****************************************************************************
@@ -796,7 +833,7 @@ fio_protocol_s *http1_new(uintptr_t uuid, http_settings_s *settings,
                           void *unread_data, size_t unread_length) {
   if (unread_data && unread_length > HTTP_MAX_HEADER_LENGTH)
     return NULL;
-  http1pr_s *p = fio_malloc(sizeof(*p) + HTTP_MAX_HEADER_LENGTH);
+  http1pr_s *p = fio_malloc(sizeof(*p));
   // FIO_LOG_DEBUG("Allocated HTTP/1.1 protocol at. %p", (void *)p);
   FIO_ASSERT_ALLOC(p);
   *p = (http1pr_s){
@@ -812,7 +849,9 @@ fio_protocol_s *http1_new(uintptr_t uuid, http_settings_s *settings,
       .is_client = settings->is_client,
   };
   http_s_new(&p->request, &p->p, &HTTP1_VTABLE);
-  if (unread_data && unread_length <= HTTP_MAX_HEADER_LENGTH) {
+  if (unread_data && unread_length) {
+    p->buf = fio_buffer_borrow(HTTP_MAX_HEADER_LENGTH);
+    FIO_ASSERT_ALLOC(p->buf);
     memcpy(p->buf, unread_data, unread_length);
     p->buf_len = unread_length;
   }
@@ -828,6 +867,7 @@ void http1_destroy(fio_protocol_s *pr) {
   http1pr_s *p = (http1pr_s *)pr;
   http1_pr2handle(p).status = 0;
   http_s_destroy(&http1_pr2handle(p), 0);
+  fio_buffer_return(p->buf);
   fio_free(p);
   // FIO_LOG_DEBUG("Deallocated HTTP/1.1 protocol at. %p", (void *)p);
 }
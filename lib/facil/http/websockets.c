@@ -58,40 +58,35 @@ void free_ws_buffer(ws_s *owner, struct buffer_s);
 #define WS_INITIAL_BUFFER_SIZE 4096UL
 
 /*******************************************************************************
-Buffer management - simple implementation...
-Since Websocket connections have a long life expectancy, optimizing this part of
-the code probably wouldn't offer a high performance boost.
+Buffer management - pooled implementation...
+Websocket connections have a long life expectancy but are mostly idle, so the
+buffer is borrowed from the facil.io buffer pool only while a frame is
+partially consumed (see `on_data`) and returned once the data was consumed.
 */
 
-// buffer increments by 4,096 Bytes (4Kb)
-#define round_up_buffer_size(size) (((size) >> 12) + 1) << 12
-
 struct buffer_s create_ws_buffer(ws_s *owner) {
   (void)(owner);
   struct buffer_s buff;
-  buff.size = WS_INITIAL_BUFFER_SIZE;
-  buff.data = malloc(buff.size);
+  buff.data = fio_buffer_borrow(WS_INITIAL_BUFFER_SIZE);
+  buff.size = fio_buffer_capacity(buff.data);
   return buff;
 }
 
 struct buffer_s resize_ws_buffer(ws_s *owner, struct buffer_s buff) {
-  buff.size = round_up_buffer_size(buff.size);
-  void *tmp = realloc(buff.data, buff.size);
-  if (!tmp) {
-    free_ws_buffer(owner, buff);
-    buff.data = NULL;
-    buff.size = 0;
-  }
+  (void)(owner);
+  void *tmp = fio_buffer_borrow(buff.size);
+  if (tmp && buff.data)
+    memcpy(tmp, buff.data, fio_buffer_capacity(buff.data));
+  fio_buffer_return(buff.data);
   buff.data = tmp;
+  buff.size = fio_buffer_capacity(tmp);
   return buff;
 }
 void free_ws_buffer(ws_s *owner, struct buffer_s buff) {
   (void)(owner);
-  free(buff.data);
+  fio_buffer_return(buff.data);
 }
 
-#undef round_up_buffer_size
-
 /*******************************************************************************
 Create/Destroy the websocket object (prototypes)
 */
@@ -244,10 +239,26 @@ static uint8_t on_shutdown(intptr_t fd, fio_protocol_s *ws) {
   return 0;
 }
 
+/* returns the buffer once all the data was consumed */
+static inline void ws_buffer_release(ws_s *ws) {
+  if (ws->length || !ws->buffer.data)
+    return;
+  free_ws_buffer(ws, ws->buffer);
+  ws->buffer = (struct buffer_s){.data = NULL};
+}
+
 static void on_data(intptr_t sockfd, fio_protocol_s *ws_) {
   ws_s *const ws = (ws_s *)ws_;
   if (ws == NULL)
     return;
+  if (!ws->buffer.data) {
+    ws->buffer = create_ws_buffer(ws);
+    if (!ws->buffer.data) {
+      // no memory.
+      websocket_close(ws);
+      return;
+    }
+  }
   struct websocket_packet_info_s info =
       websocket_buffer_peek(ws->buffer.data, ws->length);
   const uint64_t raw_length = info.packet_length + info.head_length;
@@ -271,10 +282,12 @@ static void on_data(intptr_t sockfd, fio_protocol_s *ws_) {
   const ssize_t len = fio_read(sockfd, (uint8_t *)ws->buffer.data + ws->length,
                                ws->buffer.size - ws->length);
   if (len <= 0) {
+    ws_buffer_release(ws);
     return;
   }
   ws->length = websocket_consume(ws->buffer.data, ws->length + len, ws,
                                  (~(ws->is_client) & 1));
+  ws_buffer_release(ws);
 
   fio_force_event(sockfd, FIO_EVENT_ON_DATA);
 }
@@ -289,6 +302,7 @@ static void on_data_first(intptr_t sockfd, fio_protocol_s *ws_) {
   if (ws->length) {
     ws->length = websocket_consume(ws->buffer.data, ws->length, ws,
                                    (~(ws->is_client) & 1));
+    ws_buffer_release(ws);
   }
   fio_force_event(sockfd, FIO_EVENT_ON_DATA);
   fio_force_event(sockfd, FIO_EVENT_ON_READY);
@@ -331,8 +345,6 @@ void websocket_attach(intptr_t uuid, http_settings_s *http_settings,
                       websocket_settings_s *args, void *data, size_t length) {
   ws_s *ws = new_websocket(uuid);
   FIO_ASSERT_ALLOC(ws);
-  // we have an active websocket connection - prep the connection buffer
-  ws->buffer = create_ws_buffer(ws);
   // Setup ws callbacks
   ws->on_open = args->on_open;
   ws->on_close = args->on_close;
@@ -354,6 +366,7 @@ void websocket_attach(intptr_t uuid, http_settings_s *http_settings,
   }
 
   if (data && length) {
+    ws->buffer = create_ws_buffer(ws);
     if (length > ws->buffer.size) {
       ws->buffer.size = length;
       ws->buffer = resize_ws_buffer(ws, ws->buffer);
@@ -0,0 +1,222 @@
+/*
+Copyright 2019, Boaz Segev
+License: ISC
+
+Measures a connection storm: many clients connecting (almost) at once.
+
+An echo server is run in-process while client threads open all their
+connections as fast as they can, sending a single byte on each connection and
+waiting for the echo. The time from `connect` to the echo (the accept latency,
+as experienced by the client) is collected for every connection.
+
+Compile once with the default accept batch and once accepting a single
+connection per event to compare:
+
+    gcc -O2 -Ilib/facil lib/facil/fio.c tests/accept_storm.c \
+        -o /tmp/storm_batch -lpthread -lm
+    gcc -O2 -Ilib/facil -DFIO_LISTEN_ACCEPT_BATCH=1 lib/facil/fio.c \
+        tests/accept_storm.c -o /tmp/storm_single -lpthread -lm
+
+Arguments (optional): [client threads] [connections per client] [server
+threads]
+*/
+#include <fio.h>
+
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TEST_PORT "3378"
+
+#ifndef FIO_LISTEN_ACCEPT_BATCH
+#define FIO_LISTEN_ACCEPT_BATCH 32
+#endif
+
+static size_t client_count = 16;
+static size_t connection_count = 128;
+static size_t errors;
+static size_t clients_done;
+/* accept latencies, in microseconds (one per connection) */
+static uint32_t *latency;
+
+/* *****************************************************************************
+Echo server
+***************************************************************************** */
+
+static void echo_on_data(intptr_t uuid, fio_protocol_s *pr) {
+  char buf[64];
+  ssize_t len;
+  while ((len = fio_read(uuid, buf, sizeof(buf))) > 0)
+    fio_write(uuid, buf, len);
+  (void)pr;
+}
+
+static void echo_on_close(intptr_t uuid, fio_protocol_s *pr) {
+  fio_free(pr);
+  (void)uuid;
+}
+
+static void echo_on_open(intptr_t uuid, void *udata) {
+  fio_protocol_s *pr = fio_malloc(sizeof(*pr));
+  *pr = (fio_protocol_s){
+      .on_data = echo_on_data,
+      .on_close = echo_on_close,
+  };
+  fio_attach(uuid, pr);
+  (void)udata;
+}
+
+/* *****************************************************************************
+Storming clients (plain threads, outside of the reactor)
+***************************************************************************** */
+
+static inline uint64_t now_us(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return ((uint64_t)t.tv_sec * 1000000) + ((uint64_t)t.tv_nsec / 1000);
+}
+
+static void *client_task(void *arg) {
+  const size_t index = (uintptr_t)arg;
+  struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+  struct addrinfo *addr = NULL;
+  struct pollfd *fds = calloc(connection_count, sizeof(*fds));
+  uint64_t *started = calloc(connection_count, sizeof(*started));
+  uint32_t *lat = latency + (index * connection_count);
+  size_t waiting = 0;
+  if (!fds || !started || getaddrinfo("127.0.0.1", TEST_PORT, &hints, &addr)) {
+    fio_atomic_add(&errors, connection_count);
+    goto finish;
+  }
+  /* the storm: connect and send a byte, without waiting for replies */
+  for (size_t i = 0; i < connection_count; ++i) {
+    fds[i] = (struct pollfd){.fd = -1, .events = POLLIN};
+    started[i] = now_us();
+    int fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+    if (fd == -1 || connect(fd, addr->ai_addr, addr->ai_addrlen) ||
+        write(fd, "s", 1) != 1) {
+      if (fd != -1)
+        close(fd);
+      fio_atomic_add(&errors, 1);
+      continue;
+    }
+    fds[i].fd = fd;
+    ++waiting;
+  }
+  /* collect the echoes */
+  while (waiting) {
+    if (poll(fds, connection_count, 5000) <= 0) {
+      fio_atomic_add(&errors, waiting);
+      break;
+    }
+    const uint64_t t = now_us();
+    for (size_t i = 0; i < connection_count; ++i) {
+      char c;
+      if (fds[i].fd == -1 || !fds[i].revents)
+        continue;
+      if (read(fds[i].fd, &c, 1) != 1 || c != 's')
+        fio_atomic_add(&errors, 1);
+      else
+        lat[i] = (uint32_t)(t - started[i]);
+      close(fds[i].fd);
+      fds[i].fd = -1;
+      --waiting;
+    }
+  }
+finish:
+  for (size_t i = 0; fds && i < connection_count; ++i) {
+    if (fds[i].fd != -1)
+      close(fds[i].fd);
+  }
+  free(fds);
+  free(started);
+  if (addr)
+    freeaddrinfo(addr);
+  if (fio_atomic_add(&clients_done, 1) == client_count)
+    fio_stop();
+  return NULL;
+}
+
+static void start_clients(void *arg) {
+  for (size_t i = 0; i < client_count; ++i) {
+    pthread_t t;
+    if (pthread_create(&t, NULL, client_task, (void *)i)) {
+      perror("ERROR: couldn't spawn client thread");
+      exit(-1);
+    }
+    pthread_detach(t);
+  }
+  (void)arg;
+}
+
+/* *****************************************************************************
+Main
+***************************************************************************** */
+
+static int latency_cmp(const void *a, const void *b) {
+  const uint32_t x = *(const uint32_t *)a;
+  const uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char const *argv[]) {
+  size_t threads = 1;
+  struct timespec start, end;
+  if (argc > 1)
+    client_count = (size_t)atol(argv[1]);
+  if (argc > 2)
+    connection_count = (size_t)atol(argv[2]);
+  if (argc > 3)
+    threads = (size_t)atol(argv[3]);
+  if (!client_count || !connection_count || !threads) {
+    fprintf(stderr, "usage: %s [clients] [connections] [threads]\n", argv[0]);
+    return -1;
+  }
+  const size_t total = client_count * connection_count;
+  latency = calloc(total, sizeof(*latency));
+  if (!latency) {
+    perror("ERROR: couldn't allocate latency log");
+    return -1;
+  }
+  if (fio_listen(.port = TEST_PORT, .address = "127.0.0.1",
+                 .on_open = echo_on_open) == -1) {
+    perror("ERROR: couldn't listen on port " TEST_PORT);
+    return -1;
+  }
+  fio_state_callback_add(FIO_CALL_ON_START, start_clients, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  fio_start(.threads = (int16_t)threads, .workers = 1);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  fio_stats_s s = fio_stats();
+  double secs = (end.tv_sec - start.tv_sec) +
+                ((double)(end.tv_nsec - start.tv_nsec) / 1000000000.0);
+  /* failed connections have no latency (0), they're sorted first */
+  qsort(latency, total, sizeof(*latency), latency_cmp);
+  const size_t ok = total - (errors < total ? errors : total);
+  const uint32_t *lat = latency + (total - ok);
+  fprintf(stderr,
+          "Accept batch:      %zu\n"
+          "Connections:       %zu (%zu clients, %zu server threads)\n"
+          "Errors:            %zu\n"
+          "Time:              %.3f sec (%.0f conn/sec)\n"
+          "Latency (us):      p50 %u, p99 %u, max %u\n"
+          "poll calls / conn: %.3f\n"
+          "poll events/ conn: %.3f\n"
+          "parked / conn:     %.3f\n"
+          "wake calls / conn: %.3f\n",
+          (size_t)FIO_LISTEN_ACCEPT_BATCH, total, client_count, threads,
+          errors, secs, total / secs, (ok ? lat[ok / 2] : 0),
+          (ok ? lat[(ok * 99) / 100] : 0), (ok ? lat[ok - 1] : 0),
+          (double)s.poll_calls / total, (double)s.poll_events / total,
+          (double)s.thread_parks / total, (double)s.thread_wakes / total);
+  free(latency);
+  return errors ? -1 : 0;
+}
@@ -0,0 +1,121 @@
+/*
+Copyright 2019, Boaz Segev
+License: ISC
+
+A (white box) connection table microbenchmark.
+
+The connection table is filled with (fake) open connections and:
+
+* IO events are dispatched in a random order, touching the connection state the
+  same way the reactor does for every event (uuid validation, scheduling flag,
+  protocol lock, read hooks and activity time stamp).
+
+* The whole table is reviewed, the way `fio_flush_all` and `fio_stats` review
+  all the connections.
+
+No system calls are made, so the result reflects the cost of reaching the
+connection data (cache misses).
+
+    gcc -O2 -DNDEBUG -Ilib/facil tests/fd_table.c -o /tmp/fd_table \
+        -lpthread -lm && /tmp/fd_table 100000
+
+The number of connections is limited by the process's open file limit (see
+`fio_capa`).
+
+Arguments (optional): [connections] [events (millions)]
+*/
+#include "fio.c" /* white box - the connection table isn't exposed */
+
+static fio_protocol_s fd_table_protocol;
+
+/* a simple PRNG, so the event order isn't cache friendly */
+static inline uint64_t fd_table_rand(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+/* the state reviewed for an IO event, returns 1 if the event was performed */
+static inline size_t fd_table_event(intptr_t fd, time_t now) {
+  intptr_t uuid = fd2uuid(fd);
+  if (!uuid_is_valid(uuid) || !uuid_data(uuid).open)
+    return 0;
+  if (fio_trylock(&uuid_data(uuid).scheduled))
+    return 0;
+  fio_protocol_s *pr = protocol_try_lock(fd, FIO_PR_LOCK_TASK);
+  if (!pr) {
+    fio_unlock(&uuid_data(uuid).scheduled);
+    return 0;
+  }
+  uuid_data(uuid).active = now;
+  size_t ret = (uuid_data(uuid).rw_hooks == &FIO_DEFAULT_RW_HOOKS &&
+                !uuid_data(uuid).rw_udata && !uuid_data(uuid).packet);
+  protocol_unlock(pr, FIO_PR_LOCK_TASK);
+  fio_unlock(&uuid_data(uuid).scheduled);
+  return ret;
+}
+
+int main(int argc, char const *argv[]) {
+  size_t count = 100000;
+  size_t events = 20;
+  if (argc > 1)
+    count = (size_t)atol(argv[1]);
+  if (argc > 2)
+    events = (size_t)atol(argv[2]);
+  events *= 1000000;
+  if (count + 64 > fio_capa()) {
+    fprintf(stderr, "* connections limited by capacity (%zu => %zu)\n", count,
+            fio_capa() - 64);
+    count = fio_capa() - 64;
+  }
+  /* leave the file descriptors that might be in use (stdio, polling, etc') */
+  const size_t first = 64;
+  const size_t end = first + count;
+  fio_fd_data_reserve(end - 1);
+  for (size_t i = first; i < end; ++i) {
+    fd_data(i).open = 1;
+    fd_data(i).protocol = &fd_table_protocol;
+  }
+
+  uint64_t rnd = 0x9E3779B97F4A7C15ULL;
+  size_t performed = 0;
+  struct timespec start, finish;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  const time_t now = start.tv_sec;
+  for (size_t i = 0; i < events; ++i) {
+    performed += fd_table_event(first + (fd_table_rand(&rnd) % count), now);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  double secs = (finish.tv_sec - start.tv_sec) +
+                ((double)(finish.tv_nsec - start.tv_nsec) / 1000000000.0);
+
+  size_t reviewed = 0;
+  const size_t passes = events / count;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (size_t pass = 0; pass < passes; ++pass) {
+    for (size_t i = 0; i < end; ++i) {
+      if (fd_data(i).open && !fd_data(i).packet)
+        ++reviewed;
+    }
+    __asm__ volatile("" ::: "memory");
+  }
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  double review_secs =
+      (finish.tv_sec - start.tv_sec) +
+      ((double)(finish.tv_nsec - start.tv_nsec) / 1000000000.0);
+
+  for (size_t i = first; i < end; ++i) {
+    fd_data(i).open = 0;
+    fd_data(i).protocol = NULL;
+  }
+  fprintf(stderr,
+          "Connections:       %zu (%zu bytes per connection for IO events)\n"
+          "Events:            %zu (%zu performed)\n"
+          "Events per second: %.0f\n"
+          "Reviewed:          %zu connections (%zu passes)\n"
+          "Reviews per second: %.0f\n",
+          count, sizeof(fd_data(0)), events, performed, events / secs,
+          reviewed, passes, reviewed / review_secs);
+  return performed != events || reviewed != passes * count;
+}
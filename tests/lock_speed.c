@@ -0,0 +1,120 @@
+/*
+Copyright 2019, Boaz Segev
+License: ISC
+
+A lock contention benchmark, comparing the spinlock (`fio_lock_i`), the
+adaptive lock (`fio_mutex_i`) and `pthread_mutex_t`.
+
+Threads compete for a single lock, performing a short or a long critical
+section. The wall time and the CPU time (user + system) are reported, since
+waiting threads that don't sleep burn CPU that could be used elsewhere.
+
+    gcc -O2 -Ilib/facil tests/lock_speed.c -o /tmp/lock_speed -lpthread && \
+        /tmp/lock_speed
+
+Arguments (optional): [threads] [iterations per thread]
+*/
+#include <fio.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+static size_t thread_count = 8;
+static size_t iterations = 200000;
+static size_t critical_work;
+
+static fio_lock_i spin_lock = FIO_LOCK_INIT;
+static fio_mutex_i adaptive_lock = FIO_MUTEX_INIT;
+static pthread_mutex_t pthread_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile size_t counter;
+
+/* work performed within the critical section */
+static inline void critical_section(void) {
+  for (size_t i = 0; i < critical_work; ++i)
+    __asm__ volatile("" ::: "memory");
+  ++counter;
+}
+
+static void *spin_task(void *arg) {
+  for (size_t i = 0; i < iterations; ++i) {
+    fio_lock(&spin_lock);
+    critical_section();
+    fio_unlock(&spin_lock);
+  }
+  return arg;
+}
+
+static void *adaptive_task(void *arg) {
+  for (size_t i = 0; i < iterations; ++i) {
+    fio_mutex_lock(&adaptive_lock);
+    critical_section();
+    fio_mutex_unlock(&adaptive_lock);
+  }
+  return arg;
+}
+
+static void *pthread_task(void *arg) {
+  for (size_t i = 0; i < iterations; ++i) {
+    pthread_mutex_lock(&pthread_lock);
+    critical_section();
+    pthread_mutex_unlock(&pthread_lock);
+  }
+  return arg;
+}
+
+static double cpu_time(void) {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+         ((ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000000.0);
+}
+
+static void run_test(const char *name, void *(*task)(void *)) {
+  pthread_t *threads = malloc(sizeof(*threads) * thread_count);
+  struct timespec start, end;
+  double cpu = cpu_time();
+  counter = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (size_t i = 0; i < thread_count; ++i) {
+    if (pthread_create(threads + i, NULL, task, NULL)) {
+      perror("ERROR: couldn't spawn thread");
+      exit(-1);
+    }
+  }
+  for (size_t i = 0; i < thread_count; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  cpu = cpu_time() - cpu;
+  free(threads);
+  double secs = (end.tv_sec - start.tv_sec) +
+                ((double)(end.tv_nsec - start.tv_nsec) / 1000000000.0);
+  fprintf(stderr, "%-10s %10.0f locks/sec  wall %7.3f sec  cpu %7.3f sec%s\n",
+          name, counter / secs, secs, cpu,
+          (counter == thread_count * iterations) ? "" : "  (ERROR!)");
+}
+
+int main(int argc, char const *argv[]) {
+  if (argc > 1)
+    thread_count = (size_t)atol(argv[1]);
+  if (argc > 2)
+    iterations = (size_t)atol(argv[2]);
+  if (!thread_count || !iterations) {
+    fprintf(stderr, "usage: %s [threads] [iterations]\n", argv[0]);
+    return -1;
+  }
+  size_t work[] = {0, 2000};
+  for (size_t i = 0; i < sizeof(work) / sizeof(work[0]); ++i) {
+    critical_work = work[i];
+    fprintf(stderr, "\n%zu threads X %zu locks, critical section: %s\n",
+            thread_count, iterations, (work[i] ? "long" : "short"));
+    run_test("spinlock", spin_task);
+    run_test("adaptive", adaptive_task);
+    run_test("pthread", pthread_task);
+  }
+  return 0;
+}
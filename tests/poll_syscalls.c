@@ -0,0 +1,176 @@
+/*
+Copyright 2019, Boaz Segev
+License: ISC
+
+Counts the system calls the reactor makes per message, using `fio_stats`.
+
+An echo server is run in-process while a few client threads perform a
+ping-pong exchange. Compile once with the default (level triggered) polling
+and once with edge triggered `epoll` to compare (with more than one server
+thread, idle threads are parked and woken as tasks are scheduled):
+
+    gcc -O2 -Ilib/facil lib/facil/fio.c tests/poll_syscalls.c \
+        -o /tmp/poll_lt -lpthread -lm
+    gcc -O2 -Ilib/facil -DFIO_POLL_EDGE=1 lib/facil/fio.c \
+        tests/poll_syscalls.c -o /tmp/poll_et -lpthread -lm
+
+Arguments (optional): [clients] [messages per client] [server threads]
+*/
+#include <fio.h>
+
+#include <netdb.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TEST_PORT "3377"
+#define TEST_MSG_LEN 64
+
+#ifndef FIO_POLL_EDGE
+#define FIO_POLL_EDGE 0
+#endif
+
+static size_t client_count = 8;
+static size_t message_count = 10000;
+static size_t errors;
+static size_t clients_done;
+
+/* *****************************************************************************
+Echo server
+***************************************************************************** */
+
+static void echo_on_data(intptr_t uuid, fio_protocol_s *pr) {
+  char buf[4096];
+  ssize_t len;
+  /* read until the socket is drained (required for edge triggered polling) */
+  while ((len = fio_read(uuid, buf, sizeof(buf))) > 0)
+    fio_write(uuid, buf, len);
+  (void)pr;
+}
+
+static void echo_on_close(intptr_t uuid, fio_protocol_s *pr) {
+  fio_free(pr);
+  (void)uuid;
+}
+
+static void echo_on_open(intptr_t uuid, void *udata) {
+  fio_protocol_s *pr = fio_malloc(sizeof(*pr));
+  *pr = (fio_protocol_s){
+      .on_data = echo_on_data,
+      .on_close = echo_on_close,
+  };
+  fio_attach(uuid, pr);
+  (void)udata;
+}
+
+/* *****************************************************************************
+Blocking clients (plain threads, outside of the reactor)
+***************************************************************************** */
+
+static void *client_task(void *arg) {
+  char msg[TEST_MSG_LEN];
+  char buf[TEST_MSG_LEN];
+  struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+  struct addrinfo *addr = NULL;
+  int fd = -1;
+  memset(msg, 'a' + ((uintptr_t)arg & 15), sizeof(msg));
+  if (getaddrinfo("127.0.0.1", TEST_PORT, &hints, &addr) ||
+      (fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol)) ==
+          -1 ||
+      connect(fd, addr->ai_addr, addr->ai_addrlen)) {
+    fio_atomic_add(&errors, 1);
+    goto finish;
+  }
+  for (size_t i = 0; i < message_count; ++i) {
+    size_t got = 0;
+    if (write(fd, msg, sizeof(msg)) != (ssize_t)sizeof(msg)) {
+      fio_atomic_add(&errors, 1);
+      goto finish;
+    }
+    while (got < sizeof(buf)) {
+      ssize_t r = read(fd, buf + got, sizeof(buf) - got);
+      if (r <= 0) {
+        fio_atomic_add(&errors, 1);
+        goto finish;
+      }
+      got += r;
+    }
+    if (memcmp(msg, buf, sizeof(buf)))
+      fio_atomic_add(&errors, 1);
+  }
+finish:
+  if (fd != -1)
+    close(fd);
+  if (addr)
+    freeaddrinfo(addr);
+  if (fio_atomic_add(&clients_done, 1) == client_count)
+    fio_stop();
+  return NULL;
+}
+
+static void start_clients(void *arg) {
+  for (size_t i = 0; i < client_count; ++i) {
+    pthread_t t;
+    if (pthread_create(&t, NULL, client_task, (void *)i)) {
+      perror("ERROR: couldn't spawn client thread");
+      exit(-1);
+    }
+    pthread_detach(t);
+  }
+  (void)arg;
+}
+
+/* *****************************************************************************
+Main
+***************************************************************************** */
+
+int main(int argc, char const *argv[]) {
+  size_t threads = 1;
+  struct timespec start, end;
+  if (argc > 1)
+    client_count = (size_t)atol(argv[1]);
+  if (argc > 2)
+    message_count = (size_t)atol(argv[2]);
+  if (argc > 3)
+    threads = (size_t)atol(argv[3]);
+  if (!client_count || !message_count || !threads) {
+    fprintf(stderr, "usage: %s [clients] [messages] [threads]\n", argv[0]);
+    return -1;
+  }
+  if (fio_listen(.port = TEST_PORT, .address = "127.0.0.1",
+                 .on_open = echo_on_open) == -1) {
+    perror("ERROR: couldn't listen on port " TEST_PORT);
+    return -1;
+  }
+  fio_state_callback_add(FIO_CALL_ON_START, start_clients, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  fio_start(.threads = (int16_t)threads, .workers = 1);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  fio_stats_s s = fio_stats();
+  double total = (double)(client_count * message_count);
+  double secs = (end.tv_sec - start.tv_sec) +
+                ((double)(end.tv_nsec - start.tv_nsec) / 1000000000.0);
+  fprintf(stderr,
+          "Polling mode:      %s\n"
+          "Messages:          %zu (%zu clients, %zu server threads)\n"
+          "Errors:            %zu\n"
+          "Time:              %.3f sec (%.0f msg/sec)\n"
+          "poll calls / msg:  %.3f\n"
+          "poll events / msg: %.3f\n"
+          "re-arming / msg:   %.3f\n"
+          "read calls / msg:  %.3f\n"
+          "parked / msg:      %.3f\n"
+          "wake calls / msg:  %.3f\n",
+          FIO_POLL_EDGE ? "edge triggered" : "level triggered",
+          (size_t)total, client_count, threads, errors, secs, total / secs,
+          s.poll_calls / total, s.poll_events / total, s.poll_arms / total,
+          s.read_calls / total, s.thread_parks / total,
+          s.thread_wakes / total);
+  return errors ? -1 : 0;
+}